@@ -9,19 +9,16 @@
 /******************************************************************************/
 #include "oled1106.h"
 
-/* SH1106 general definitions */
+/* SH1106 general definitions (pixel modes are in oled1106.h)                 */
 
-#define PIXOFF          0       // Set pixel off
-#define PIXON           1       // Set pixel on
-#define PIXINV          2       // Invert pixel (ON becomes OFF, OFF becomes ON)
-#define FBONLY          1       // Write to the framebufffer only
-#define FBANDDISPLAY    2       // Write to the framebuffer and display simultaneously.
 #define COLOFFSET       0x02    // As the addressable RAM is 132x64, but the
                                 // display is 128x64, need a column offset.
 #define COLUMNS         128     // Display has 128 columns of visible pixels.
 #define ROWS            64      // Display has 64 rows of visible pixels.
 #define PAGES           8       // The top line of the diplay is on page 8.
 #define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ROTCROP         32      // When turned 90 or 270 degrees, only the 64
+#define ROTCROPW        64      // columns from ROTCROP (0 based) are visible.
 #define CHARSPERPAGE    16      // The number of 8x8 character cells per page.
 #define STDCHARWIDTH    8       // The width of a 8x8 character cell.
 #define ORIGIN          1       // Defines the origin point for the library.
@@ -31,21 +28,11 @@
                                 // want the bottom left co-ordinate to be (0,0)
                                 // but this is untested.
 
-/* SH1106 library error codes */
-
-#define PAGETOOLOW      -1000   // Page specified as 0 or lower
-#define PAGETOOHIGH     -1001   // Page specified as 9 or higher
-#define BADPIXELCMD     -1002   // Command not PIXON, PIXOFF or PIXINV
-#define COLOUTOFRANGE   -1003   // Column is < ORIGIN or > ORIGIN+127
-#define ROWOUTOFRANGE   -1004   // Row is < ORIGIN or > ORIGIN+63
-#define NEGORZERORADIUS -1005   // Tried to draw a circle with negative or zero radius
-#define INVALIDFBCODE   -1006   // Framebuffer write code is invalid
-
 /* SH1106 internal library global variables */
 
 /* SH1106 global framebuffer */
 
-static char oled1106fb[8][128];    // An alternative way of implementing this
+static char oledfbstore[8][128];   // An alternative way of implementing this
                                    // so that individual pixels on the display
                                    // can be turned on or off without impacting
                                    // others would be to read from the display
@@ -53,108 +40,142 @@ static char oled1106fb[8][128];    // An alternative way of implementing this
                                    // The pi is not short of memory, so this is
                                    // likely to be faster. (8 pages, 128 columns)
 
-/* A simple SH1106 font - a 7x7(ish) font on an 8x8 grid. */
-/* Uses printing 'ASCII' codes 32-127.                    */
-/* Note - the characters are mirror images due to         */
-/* a cockup when defining them. The oledstr()             */
-/* function takes care of this ...                        */
-
-static char oledf8x8[96][8] =    { {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},     //  32 Space
-                                   {0x00, 0x00, 0x00, 0x7a, 0x7a, 0x00, 0x00, 0x00},     //  33 !
-                                   {0x00, 0x00, 0x60, 0x00, 0x00, 0x60, 0x00, 0x00},     //  34 "
-                                   {0x00, 0x24, 0x7e, 0x24, 0x24, 0x7e, 0x24, 0x00},     //  35 #
-                                   {0x00, 0x4c, 0x52, 0xff, 0xff, 0x52, 0x22, 0x00},     //  36 $
-                                   {0x00, 0x0c, 0x52, 0x32, 0x7c, 0x98, 0x94, 0x60},     //  37 %
-                                   {0x00, 0x42, 0x84, 0x8c, 0x92, 0x72, 0x12, 0x0c},     //  38 &
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x00},     //  39 '
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x44, 0x38},     //  40 (
-                                   {0x00, 0x38, 0x44, 0x82, 0x00, 0x00, 0x00, 0x00},     //  41 )
-                                   {0x00, 0x92, 0x54, 0x38, 0xfe, 0x38, 0x54, 0x92},     //  42 *
-                                   {0x00, 0x10, 0x10, 0x10, 0xfe, 0x10, 0x10, 0x10},     //  43 +
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0a, 0x00},     //  44 ,
-                                   {0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},     //  45 -
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c, 0x00},     //  46 .
-                                   {0x00, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02},     //  47 slash
-                                   {0x00, 0x7c, 0xc2, 0xa2, 0x92, 0x8a, 0x86, 0x7c},     //  48 0
-                                   {0x00, 0x02, 0x02, 0x02, 0xfe, 0x42, 0x22, 0x02},     //  49 1
-                                   {0x00, 0x62, 0x92, 0x92, 0x92, 0x92, 0x92, 0x4e},     //  50 2
-                                   {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x82, 0x44},     //  51 3
-                                   {0x00, 0x08, 0x08, 0x08, 0x7e, 0x08, 0x08, 0xf0},     //  52 4
-                                   {0x00, 0x8c, 0x92, 0x92, 0x92, 0x92, 0x92, 0xf2},     //  53 5
-                                   {0x00, 0x4c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x7e},     //  54 6
-                                   {0x00, 0x80, 0xc0, 0xa0, 0x90, 0x88, 0x84, 0x82},     //  55 7
-                                   {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x6c},     //  56 8
-                                   {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x62},     //  57 9
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x6c, 0x6c, 0x00},     //  58 :
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x6c, 0x6a, 0x00},     //  59 ;
-                                   {0x00, 0x00, 0x00, 0x00, 0x82, 0x44, 0x28, 0x10},     //  60 <
-                                   {0x00, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x00},     //  61 =
-                                   {0x00, 0x10, 0x28, 0x44, 0x82, 0x00, 0x00, 0x00},     //  62 >
-                                   {0x00, 0x00, 0x70, 0x90, 0x9a, 0x80, 0x60, 0x00},     //  63 ?
-                                   {0x00, 0x44, 0xb2, 0xaa, 0xaa, 0x92, 0x42, 0x3c},     //  64 @
-                                   {0x00, 0x7e, 0x90, 0x90, 0x90, 0x90, 0x90, 0x7e},     //  65 A
-                                   {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0xfe},     //  66 B
-                                   {0x00, 0x44, 0x82, 0x82, 0x82, 0x82, 0x82, 0x7c},     //  67 C
-                                   {0x00, 0x38, 0x44, 0x82, 0x82, 0x82, 0x82, 0xfe},     //  68 D
-                                   {0x00, 0x82, 0x92, 0x92, 0x92, 0x92, 0x92, 0xfe},     //  69 E
-                                   {0x00, 0x80, 0x90, 0x90, 0x90, 0x90, 0x90, 0xfe},     //  70 F
-                                   {0x00, 0x5c, 0x92, 0x92, 0x92, 0x82, 0x42, 0x3c},     //  71 G
-                                   {0x00, 0xfe, 0x10, 0x10, 0x10, 0x10, 0x10, 0xfe},     //  72 H
-                                   {0x00, 0x82, 0x82, 0x82, 0xfe, 0x82, 0x82, 0x82},     //  73 I
-                                   {0x00, 0x80, 0x80, 0xfe, 0x82, 0x82, 0x82, 0x04},     //  74 J
-                                   {0x00, 0x02, 0x86, 0x4c, 0x38, 0x10, 0x10, 0xfe},     //  75 K
-                                   {0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0xfe},     //  76 L
-                                   {0x00, 0xfe, 0x40, 0x20, 0x10, 0x20, 0x40, 0xfe},     //  77 M
-                                   {0x00, 0xfe, 0x04, 0x08, 0x10, 0x20, 0x40, 0xfe},     //  78 N
-                                   {0x00, 0x7c, 0x82, 0x82, 0x82, 0x82, 0x82, 0x7c},     //  79 O
-                                   {0x00, 0x60, 0x90, 0x90, 0x90, 0x90, 0x90, 0xfe},     //  80 P
-                                   {0x00, 0x7a, 0x84, 0x8a, 0x82, 0x82, 0x82, 0x7e},     //  81 Q
-                                   {0x00, 0x62, 0x94, 0x98, 0x90, 0x90, 0x90, 0xfe},     //  82 R
-                                   {0x00, 0x4c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x64},     //  83 S
-                                   {0x00, 0x80, 0x80, 0x80, 0xfe, 0x80, 0x80, 0x80},     //  84 T
-                                   {0x00, 0xfc, 0x02, 0x02, 0x02, 0x02, 0x02, 0xfc},     //  85 U
-                                   {0x00, 0xf0, 0x08, 0x04, 0x02, 0x04, 0x08, 0xf0},     //  86 V
-                                   {0x00, 0xfe, 0x04, 0x08, 0x10, 0x08, 0x04, 0xfe},     //  87 W
-                                   {0x00, 0x82, 0x44, 0x28, 0x10, 0x28, 0x44, 0x82},     //  88 X
-                                   {0x00, 0x80, 0x40, 0x20, 0x1e, 0x20, 0x40, 0x80},     //  89 Y
-                                   {0x00, 0x82, 0xc2, 0xa2, 0x92, 0x8a, 0x86, 0x82},     //  90 Z
-                                   {0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x82, 0xfe},     //  91 [
-                                   {0x00, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80},     //  92 backslash
-                                   {0x00, 0xfe, 0x82, 0x82, 0x00, 0x00, 0x00, 0x00},     //  93 ]
-                                   {0x00, 0x00, 0x20, 0x40, 0x80, 0x40, 0x20, 0x00},     //  94 ^
-                                   {0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01},     //  95 _
-                                   {0x00, 0x00, 0x00, 0x00, 0x20, 0x40, 0x80, 0x00},     //  96 backquote
-                                   {0x00, 0x36, 0x4c, 0x4a, 0x4a, 0x4a, 0x2a, 0x04},     //  97 a
-                                   {0x00, 0x0c, 0x12, 0x12, 0x12, 0x12, 0x0a, 0xfe},     //  98 b
-                                   {0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c},     //  99 c
-                                   {0x00, 0xfe, 0x12, 0x12, 0x12, 0x12, 0x0c, 0x00},     // 100 d
-                                   {0x00, 0x00, 0x34, 0x52, 0x52, 0x52, 0x52, 0x3c},     // 101 e
-                                   {0x00, 0x00, 0x80, 0x80, 0xa0, 0xa0, 0x7e, 0x20},     // 102 f
-                                   {0x00, 0x3e, 0x49, 0x49, 0x49, 0x32, 0x00, 0x00},     // 103 g
-                                   {0x00, 0x00, 0x1e, 0x10, 0x10, 0x10, 0xfe, 0x00},     // 104 h
-                                   {0x00, 0x00, 0x00, 0x02, 0x5c, 0x00, 0x00, 0x00},     // 105 i
-                                   {0x00, 0x00, 0x00, 0x5e, 0x01, 0x01, 0x00, 0x00},     // 106 j
-                                   {0x00, 0x00, 0x00, 0x02, 0x24, 0x18, 0xfe, 0x00},     // 107 k
-                                   {0x00, 0x00, 0x00, 0x02, 0xfc, 0x00, 0x00, 0x00},     // 108 l
-                                   {0x00, 0x0e, 0x10, 0x1e, 0x10, 0x10, 0x1e, 0x00},     // 109 m
-                                   {0x00, 0x00, 0x00, 0x1e, 0x10, 0x10, 0x1e, 0x00},     // 110 n
-                                   {0x00, 0x00, 0x00, 0x1c, 0x22, 0x22, 0x1c, 0x00},     // 111 o
-                                   {0x00, 0x00, 0x00, 0x30, 0x48, 0x48, 0x3f, 0x00},     // 112 p
-                                   {0x00, 0x00, 0x00, 0x3f, 0x48, 0x48, 0x30, 0x00},     // 113 q
-                                   {0x00, 0x00, 0x10, 0x20, 0x20, 0x10, 0x3e, 0x00},     // 114 r
-                                   {0x00, 0x24, 0x4a, 0x52, 0x52, 0x52, 0x24, 0x00},     // 115 s
-                                   {0x00, 0x00, 0x22, 0x22, 0xfc, 0x20, 0x00, 0x00},     // 116 t
-                                   {0x00, 0x38, 0x04, 0x04, 0x04, 0x38, 0x00, 0x00},     // 117 u
-                                   {0x00, 0x30, 0x08, 0x04, 0x08, 0x30, 0x00, 0x00},     // 118 v
-                                   {0x00, 0x00, 0x1c, 0x02, 0x04, 0x02, 0x1c, 0x00},     // 119 w
-                                   {0x00, 0x00, 0x22, 0x14, 0x08, 0x14, 0x22, 0x00},     // 120 x
-                                   {0x00, 0x00, 0x7e, 0x11, 0x11, 0x60, 0x00, 0x00},     // 121 y
-                                   {0x00, 0x00, 0x22, 0x32, 0x2a, 0x26, 0x22, 0x00},     // 122 z
-                                   {0x00, 0x00, 0x00, 0x00, 0x82, 0x92, 0x7c, 0x10},     // 123 {
-                                   {0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00},     // 124 |
-                                   {0x10, 0x7c, 0x92, 0x82, 0x00, 0x00, 0x00, 0x00},     // 125 }
-                                   {0x00, 0x10, 0x08, 0x08, 0x08, 0x10, 0x10, 0x08},     // 126 ~
-                                   {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}};    // 127 DEL
+static char (*oled1106fb)[128] = oledfbstore;  // The framebuffer all drawing
+                                   // and flushing uses. Normally oledfbstore,
+                                   // but can be pointed at any other 1024 byte
+                                   // page-major buffer (e.g. shared memory)
+                                   // with oledsetfb().
+
+/* SH1106 error reporting. The last error is kept per thread; the optional    */
+/* handler is shared by all threads.                                          */
+
+static __thread int oledlasterr = 0;
+static void (*oledhandler)(int errnum) = NULL;
+
+/* SH1106 transport. Everything sent to the display goes through oledwrite(), */
+/* which normally hands it to pigpiod. oledsettransport() can replace that,   */
+/* e.g. with a backend that records the bytes instead.                        */
+
+static int (*oledtransport)(void *ctx, int pi, int fd, char *buf, unsigned len) = NULL;
+static void *oledtransportctx = NULL;
+
+/* SH1106 write batching. Between oledbatchbegin() and oledbatchend() writes  */
+/* for pigpiod are queued as an i2c_zip() command sequence - one write        */
+/* command (7, length, data) per I2C write - and sent to the daemon in one    */
+/* request instead of one each. Per thread, as the video wall and grayscale   */
+/* presenter flush from their own threads.                                    */
+
+#define OLEDZIPMAX      1200    // A whole frame (8 writes of 135 bytes) and more
+#define OLEDZIPESC      1       // i2c_zip: next parameter is 2 bytes
+#define OLEDZIPWRITE    7       // i2c_zip: write P bytes
+#define OLEDZIPEND      0       // i2c_zip: end of commands
+
+static __thread struct {
+	int depth;                      // Nesting of oledbatchbegin()
+	int pi, fd;                     // Where the queued writes are going
+	unsigned len;                   // Bytes queued in zip
+	char zip[OLEDZIPMAX];
+} oledbatch;
+
+#ifndef OLEDNOPIGPIO
+// Shared by every thread that flushes, so only read and set atomically
+static int oledzipok = 1;               // Cleared if pigpiod can't do i2c_zip()
+#endif
+
+/* SH1106 orientation set by oledrotate(). 180 degrees and the mirrors are    */
+/* done by the controller's segment remap and COM scan direction; 90 and 270  */
+/* degrees by transposing the framebuffer as it is flushed.                   */
+
+static uint8_t oledrotation = OLEDROT0;
+static uint8_t oledmirror = 0;
+
+/* SH1106 text run cache for oledstrcached(). Runs are found through a small  */
+/* hash table and kept on a doubly linked LRU list (slot indices, -1 = none). */
+
+#define OLEDTEXTBUCKETS 64
+
+struct oledtextrun {
+	uint32_t hash;
+	int len;                        // Characters in the run, -1 if slot unused
+	uint8_t font;
+	char key[CHARSPERPAGE*4];       // The text (UTF-8, not terminated) ...
+	int keylen;                     // ... and its length in bytes
+	char bits[COLUMNS];             // Rasterised columns, 8 per character
+	int chain, newer, older;        // Hash chain and LRU links
+};
+
+static struct {
+	struct oledtextrun run[OLEDTEXTCACHE];
+	int bucket[OLEDTEXTBUCKETS];
+	int head, tail;                 // Most and least recently used
+	long hits, misses;
+} oledtext = { .head = -1 };
+
+/* Bit expansion tables for scaled text, filled on first use. Entry b of      */
+/* oledexpand[k-2] is byte b with each bit repeated k times - a glyph column  */
+/* k pages tall, the lowest page in the low byte.                             */
+
+static uint32_t oledexpand[3][256];
+static pthread_once_t oledexpandonce = PTHREAD_ONCE_INIT;
+
+/* The 8x8 font, shared with the C++ wrapper (oled1106.hpp)                   */
+
+#include "oled1106font.h"
+
+/* SH1106 internal library functions */
+
+/* Checks on the helpers the drawing loops call for every pixel. Callers have */
+/* already validated or clipped what they pass, so these only catch library   */
+/* bugs - building with -DOLEDNOCHECK takes them out of the inner loops.      */
+
+#ifdef OLEDNOCHECK
+#define OLEDHOTCHECK(cond, errnum) do { } while (0)
+#else
+#define OLEDHOTCHECK(cond, errnum) do { if (cond) { olederror(errnum); return; } } while (0)
+#endif
+
+static inline void oledpixop(char *dst, uint8_t bits, uint8_t mode) {
+	// Set, clear or invert the given bits of a framebuffer byte
+	if (mode == PIXON) *dst |= bits;
+	else if (mode == PIXOFF) *dst &= ~bits;
+	else *dst ^= bits;
+}
+
+static inline void oledplot(int x, int y, uint8_t mode) {
+	// Pixel update for callers that have already validated or clipped their
+	// co-ordinates - only checked when the library isn't built -DOLEDNOCHECK
+	OLEDHOTCHECK((x < ORIGIN) || (x > COLUMNS+ORIGIN-1), COLOUTOFRANGE);
+	OLEDHOTCHECK((y < ORIGIN) || (y > ROWS+ORIGIN-1), ROWOUTOFRANGE);
+	oledpixop(&oled1106fb[(y-ORIGIN)/ROWSPERPAGE][x-ORIGIN],0x01 << (y-ORIGIN)%ROWSPERPAGE,mode);
+}
+
+/* Byte-mask span writer. Spans on the (up to 8) rows of one page are OR-ed   */
+/* into a column mask, then applied to the framebuffer with one operation     */
+/* per column when the page is finished, rather than one per pixel. Columns   */
+/* are 0 based; *c0 and *c1 track the columns in use.                         */
+
+static inline void oledspan(uint8_t *mask, int xl, int xr, uint8_t bit, int *c0, int *c1) {
+	int c;
+
+	if (xl < 0) xl = 0;                             // Clip the span
+	if (xr > COLUMNS-1) xr = COLUMNS-1;
+	if (xl > xr) return;
+	for (c=xl; c<=xr; c++) mask[c] |= bit;
+	if (xl < *c0) *c0 = xl;
+	if (xr > *c1) *c1 = xr;
+}
+
+static void oledspanflush(int page, uint8_t *mask, uint8_t mode, int *c0, int *c1) {
+	int c;
+
+	OLEDHOTCHECK((page < 0) || (page > PAGES-1), PAGETOOHIGH);
+	for (c=*c0; c<=*c1; c++) {
+		if (mask[c]) oledpixop(&oled1106fb[page][c],mask[c],mode);
+		mask[c] = 0;
+	}
+	*c0 = COLUMNS;
+	*c1 = -1;
+}
 
 /* SH1106 external library functions */
 
@@ -162,20 +183,28 @@ void olederror_fprintf(int errnum) {
 /******************************************************************************/
 /*                                                                            */
 /* Print error code description returned from sh1106 function to stderr.      */
-/* Error codes start at -1000 and descend to -1004.                           */
+/* Error codes start at -1000 and descend to OLEDLASTERROR (see oled1106.h).  */
 /*                                                                            */
 /* (c) Tim Holyoake, 25th April 2020.                                         */
 /*                                                                            */
 /******************************************************************************/
-        char errcode[7][80]={"Page number too low (less than 1) specified",
+        char errcode[][80]={"Page number too low (less than 1) specified",
                              "Page number too high (greater than 8) specified",
                              "Invalid pixel mode - not PIXON, PIXOFF or PIXINV",
                              "Invalid x co-ordinate specified",
                              "Invalid y co-ordinate specified",
 			     "Negative or zero radius for circle specified",
-			     "Invalid framebuffer type specified"} ;
-
-        if ((errnum > PAGETOOLOW) || (errnum < INVALIDFBCODE)) {
+			     "Invalid framebuffer type specified",
+			     "Invalid image size or conversion method specified",
+			     "Invalid rotation or mirror specified",
+			     "Polygon has too few or too many vertices",
+			     "No display transport set (built without pigpiod)",
+			     "Invalid asset pack or asset not found",
+			     "Sprite layer is full",
+			     "Sprite is not on the layer",
+			     "Invalid rate or no update function specified"} ;
+
+        if ((errnum > PAGETOOLOW) || (errnum < OLEDLASTERROR)) {
 		fprintf(stderr,"Unknown SH1106 error number(%d)\n",errnum);
         }
         else {
@@ -184,6 +213,316 @@ void olederror_fprintf(int errnum) {
         return;
 }
 
+int olederror(int errnum) {
+/******************************************************************************/
+/*                                                                            */
+/* Record errnum as this thread's last error and pass it to the error         */
+/* handler, if one is set. Returns errnum so library functions can simply     */
+/* return(olederror(code)). Nothing is printed unless the handler prints -    */
+/* use oledseterrorhandler(olederror_fprintf) for the old stderr messages.    */
+/*                                                                            */
+/******************************************************************************/
+
+	oledlasterr = errnum;
+	if (oledhandler != NULL) oledhandler(errnum);
+	return(errnum);
+}
+
+int oledlasterror(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Return and clear the calling thread's last library error (0 if none).      */
+/*                                                                            */
+/******************************************************************************/
+	int errnum = oledlasterr;
+
+	oledlasterr = 0;
+	return(errnum);
+}
+
+void oledseterrorhandler(void (*handler)(int errnum)) {
+/******************************************************************************/
+/*                                                                            */
+/* Set a function to be called with every library error as it happens, or     */
+/* NULL (the default) for none. The handler runs in the thread that hit the   */
+/* error, so keep it short if errors can occur inside drawing loops.          */
+/*                                                                            */
+/******************************************************************************/
+
+	oledhandler = handler;
+	return;
+}
+
+#ifndef OLEDNOPIGPIO
+static int oledbatchsend(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Send the queued writes as one i2c_zip() request. If pigpiod doesn't know   */
+/* the command or can't take the sequence, batching is turned off and the     */
+/* writes are sent one by one instead - resending any the daemon did carry    */
+/* out is harmless, as every write sets its own page and column. Any other    */
+/* error (a NACK from the display, a bad handle) is returned and batching     */
+/* stays on.                                                                  */
+/*                                                                            */
+/******************************************************************************/
+	unsigned p, n;
+	int i;
+
+	if (oledbatch.len == 0) return(0);
+
+	oledbatch.zip[oledbatch.len] = OLEDZIPEND;
+	i = i2c_zip(oledbatch.pi,oledbatch.fd,oledbatch.zip,oledbatch.len+1,NULL,0);
+	if ((i == PI_UNKNOWN_COMMAND) || (i == PI_BAD_I2C_CMD) || (i == PI_BAD_I2C_WLEN)) {
+		__atomic_store_n(&oledzipok,0,__ATOMIC_RELAXED);
+		for (p=0, i=0; (p < oledbatch.len) && (i >= 0); p+=n) {
+			if (oledbatch.zip[p] == OLEDZIPESC) {
+				n = (uint8_t)oledbatch.zip[p+2] | ((uint8_t)oledbatch.zip[p+3] << 8);
+				p += 4;
+			}
+			else {
+				n = (uint8_t)oledbatch.zip[p+1];
+				p += 2;
+			}
+			i = i2c_write_device(oledbatch.pi,oledbatch.fd,oledbatch.zip+p,n);
+		}
+	}
+
+	oledbatch.len = 0;
+	return((i < 0) ? i : 0);
+}
+
+static int oledbatchwrite(int pi, int fd, char *buf, unsigned len) {
+	// Queue a write, sending what is already queued first if need be
+	int i;
+
+	if ((oledbatch.len > 0) &&
+	    ((pi != oledbatch.pi) || (fd != oledbatch.fd) || (oledbatch.len+len+5 > OLEDZIPMAX))) {
+		i = oledbatchsend();
+		if (i != 0) return(i);
+	}
+	if (len+5 > OLEDZIPMAX) return(i2c_write_device(pi,fd,buf,len));
+
+	oledbatch.pi = pi;
+	oledbatch.fd = fd;
+	if (len > 0xFF) oledbatch.zip[oledbatch.len++] = OLEDZIPESC;
+	oledbatch.zip[oledbatch.len++] = OLEDZIPWRITE;
+	oledbatch.zip[oledbatch.len++] = len & 0xFF;
+	if (len > 0xFF) oledbatch.zip[oledbatch.len++] = len >> 8;
+	memcpy(oledbatch.zip+oledbatch.len,buf,len);
+	oledbatch.len += len;
+	return(0);
+}
+#endif
+
+int oledwrite(int pi, int fd, char *buf, unsigned len) {
+/******************************************************************************/
+/*                                                                            */
+/* Send one I2C write (control byte(s) and payload) to the display, through   */
+/* the transport set by oledsettransport() or straight to pigpiod if none.    */
+/* A library built with -DOLEDNOPIGPIO has no pigpiod to fall back on.        */
+/*                                                                            */
+/******************************************************************************/
+
+	if (oledtransport != NULL) return(oledtransport(oledtransportctx,pi,fd,buf,len));
+#ifdef OLEDNOPIGPIO
+	return(olederror(NOTRANSPORT));
+#else
+	if ((oledbatch.depth > 0) && __atomic_load_n(&oledzipok,__ATOMIC_RELAXED))
+		return(oledbatchwrite(pi,fd,buf,len));
+	return(i2c_write_device(pi,fd,buf,len));
+#endif
+}
+
+void oledbatchbegin(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Start queueing display writes instead of sending them, so everything up to */
+/* the matching oledbatchend() reaches pigpiod as one i2c_zip() request       */
+/* rather than one request per write. Pairs may be nested; only the outer one */
+/* sends. Writes through a transport set by oledsettransport() are not        */
+/* affected. The flush functions batch their own writes.                      */
+/*                                                                            */
+/******************************************************************************/
+
+	oledbatch.depth++;
+	return;
+}
+
+int oledbatchend(void) {
+/******************************************************************************/
+/*                                                                            */
+/* End a batch started with oledbatchbegin(), sending the queued writes if it */
+/* is the outermost. Returns 0 or the pigpiod error.                          */
+/*                                                                            */
+/******************************************************************************/
+
+	if ((oledbatch.depth > 0) && (--oledbatch.depth > 0)) return(0);
+#ifdef OLEDNOPIGPIO
+	return(0);
+#else
+	return(oledbatchsend());
+#endif
+}
+
+void oledsettransport(int (*fn)(void *ctx, int pi, int fd, char *buf, unsigned len), void *ctx) {
+/******************************************************************************/
+/*                                                                            */
+/* Route all display writes through fn, which is passed ctx and the same      */
+/* arguments as i2c_write_device(). Passing NULL restores pigpiod.            */
+/*                                                                            */
+/******************************************************************************/
+
+	oledtransport = fn;
+	oledtransportctx = (fn == NULL) ? NULL : ctx;
+	return;
+}
+
+static int oledsendcols(int pi, int fd, int page, int col, const char *data, int n) {
+/******************************************************************************/
+/*                                                                            */
+/* Write n (up to 128) bytes of display data to page (0-7) starting at column */
+/* col (0-127) in a single I2C transaction. The three addressing commands     */
+/* each go with a 0x80 control byte (Co=1: another control byte follows), and */
+/* the final 0x40 control byte (Co=0, D/C=1) makes the rest of the write      */
+/* data, so there is one START/address/STOP per page instead of two.          */
+/*                                                                            */
+/******************************************************************************/
+	char buf[7+COLUMNS];
+
+	buf[0]=0x80;
+	buf[1]=(col+COLOFFSET) & 0x0F;                  // Lower column address
+	buf[2]=0x80;
+	buf[3]=0x10 | (((col+COLOFFSET) & 0xF0) >> 4);  // Higher column address
+	buf[4]=0x80;
+	buf[5]=0xB0+page;                               // Page address
+	buf[6]=0x40;                                    // Data to the end of the write
+	memcpy(buf+7,data,n);
+
+	return(oledwrite(pi,fd,buf,7+n));
+}
+
+static uint64_t oledtranspose8(uint64_t x) {
+/******************************************************************************/
+/*                                                                            */
+/* Transpose an 8x8 bit matrix held in a 64 bit word (bit 8*r+c is row r,     */
+/* column c) in three rounds of masked swaps: 1x1, then 2x2, then 4x4 blocks. */
+/*                                                                            */
+/******************************************************************************/
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+
+	return(x);
+}
+
+static void oledrottile(const char *src, char *dst) {
+/******************************************************************************/
+/*                                                                            */
+/* Turn one 8x8 tile (8 column bytes) of the framebuffer through 90 or 270    */
+/* degrees. Turning clockwise is a transpose of the tile with its columns     */
+/* taken right to left; anticlockwise a transpose written out right to left.  */
+/*                                                                            */
+/******************************************************************************/
+	uint64_t x = 0;
+	int i;
+
+	for (i=0; i<8; i++)
+		x |= (uint64_t)(uint8_t)src[(oledrotation == OLEDROT90) ? 7-i : i] << (8*i);
+
+	x = oledtranspose8(x);
+
+	for (i=0; i<8; i++)
+		dst[(oledrotation == OLEDROT90) ? i : 7-i] = (char)(x >> (8*i));
+	return;
+}
+
+static uint8_t oledsegremap(void) {
+/******************************************************************************/
+/*                                                                            */
+/* The segment remap command for the current orientation. 0xA1 (reversed) is  */
+/* the normal way up for these modules; 180 degrees or a left-right mirror    */
+/* flips it, both together cancel out.                                        */
+/*                                                                            */
+/******************************************************************************/
+
+	return(((oledrotation == OLEDROT180) ^ ((oledmirror & OLEDMIRRORX) != 0)) ? 0xA0 : 0xA1);
+}
+
+static uint8_t oledcomscan(void) {
+/******************************************************************************/
+/*                                                                            */
+/* The COM output scan direction command for the current orientation, 0xC0    */
+/* normally, flipped to 0xC8 by 180 degrees or a top-bottom mirror.           */
+/*                                                                            */
+/******************************************************************************/
+
+	return(((oledrotation == OLEDROT180) ^ ((oledmirror & OLEDMIRRORY) != 0)) ? 0xC8 : 0xC0);
+}
+
+static int oledsendfb(int pi, int fd, const char (*fb)[128], int page, int col, int n) {
+/******************************************************************************/
+/*                                                                            */
+/* Send n columns of page (0-7) of framebuffer fb from column col (0-127) to  */
+/* the display. When turned through 90 or 270 degrees only the middle 64      */
+/* columns of the framebuffer are visible; a framebuffer page becomes 8       */
+/* display columns, so each 8x8 tile the range touches is turned and sent on  */
+/* its own.                                                                   */
+/*                                                                            */
+/******************************************************************************/
+	int i, k, pcol;
+	char tile[8];
+
+	if ((oledrotation != OLEDROT90) && (oledrotation != OLEDROT270))
+		return(oledsendcols(pi,fd,page,col,fb[page]+col,n));
+
+	pcol = ROTCROP+ROWSPERPAGE*((oledrotation == OLEDROT90) ? page : PAGES-1-page);
+	for (k=0; k<ROTCROPW/8; k++) {
+		if ((col+n <= ROTCROP+8*k) || (col >= ROTCROP+8*k+8)) continue;  // Tile not in range
+		oledrottile(&fb[page][ROTCROP+8*k],tile);
+		i = oledsendcols(pi,fd,(oledrotation == OLEDROT90) ? PAGES-1-k : k,pcol,tile,8);
+		if (i != 0) return(i);
+	}
+
+	return(0);
+}
+
+static int oledsendpages(int pi, int fd, uint8_t pagemask) {
+	// oledflushpages() without the batching
+	int i, pgcount, k, n, p0, p1;
+	char buf[COLUMNS];
+
+	if ((oledrotation == OLEDROT90) || (oledrotation == OLEDROT270)) {
+		if (pagemask == 0) return(0);
+		for (p0=0; !(pagemask & (0x01 << p0)); p0++);           // First and last
+		for (p1=PAGES-1; !(pagemask & (0x01 << p1)); p1--);     // pages requested
+
+		for (k=0; k<ROTCROPW/8; k++) {                  // Each column of tiles in the crop
+			for (pgcount=p0; pgcount<=p1; pgcount++) {
+				n = (oledrotation == OLEDROT90) ? pgcount : PAGES-1-pgcount;
+				oledrottile(&oled1106fb[pgcount][ROTCROP+8*k],buf+8*n);
+			}
+			n = (oledrotation == OLEDROT90) ? p0 : PAGES-1-p1;
+			i = oledsendcols(pi,fd,(oledrotation == OLEDROT90) ? PAGES-1-k : k,
+			                 ROTCROP+8*n,buf+8*n,8*(p1-p0+1));
+			if (i != 0) return(i);                  // Error in pigpiod
+		}
+		return(0);
+	}
+
+        for (pgcount=0; pgcount<PAGES; pgcount++) { 	// Loop through pages 0xB0 to 0xB7
+		if (!(pagemask & (0x01 << pgcount))) continue;  // Page not requested
+		i = oledsendfb(pi,fd,oled1106fb,pgcount,0,COLUMNS);
+		if (i != 0) return(i);					// Error in pigpiod
+	}
+
+	return(0);
+}
+
 int oledflushfb(int pi, int fd) {
 /******************************************************************************/
 /*                                                                            */
@@ -192,26 +531,251 @@ int oledflushfb(int pi, int fd) {
 /* (c) Tim Holyoake 9th May 2020.                                             */
 /*                                                                            */
 /******************************************************************************/
-	int i, colcount, pgcount;
-	char buf[129];
 
-        for (pgcount=0; pgcount<PAGES; pgcount++) { 	// Loop through pages 0xB0 to 0xB7
-        	buf[0]=0x00;
-                buf[1]=COLOFFSET;
-                buf[2]=0x10;
-        	buf[3]=0xB0+pgcount;
-        	i = i2c_write_device(pi,fd,buf,4);      		// Set page to be flushed
-		if (i != 0) return(i);					// Error in pigpiod
+	return(oledflushpages(pi,fd,0xFF));
+}
+
+int oledflushpages(int pi, int fd, uint8_t pagemask) {
+/******************************************************************************/
+/*                                                                            */
+/* Flush selected pages of the current framebuffer to the oled display.       */
+/* Bit 0 of pagemask is page 1 (the bottom page), bit 7 is page 8 (the top    */
+/* page). Pages whose bit is clear are not sent, so callers that know which   */
+/* part of the framebuffer changed can avoid the full 1024 byte transfer.     */
+/* When turned through 90 or 270 degrees each framebuffer page ends up on     */
+/* every display page, so the turned pages are built a display page at a      */
+/* time and sent as one write each. The writes go to pigpiod as one batch.    */
+/*                                                                            */
+/******************************************************************************/
+	int i, k;
+
+	oledbatchbegin();
+	i = oledsendpages(pi,fd,pagemask);
+	k = oledbatchend();
+	return((i != 0) ? i : k);
+}
+
+int oledflushrect(int pi, int fd, int x, int y, int w, int h) {
+/******************************************************************************/
+/*                                                                            */
+/* Flush only the part of the framebuffer covering the rectangle w pixels     */
+/* wide and h high with bottom left corner (x,y). Only the columns of the     */
+/* rectangle are sent, on every page it touches, as one batch. The rectangle  */
+/* is clipped to the display, so it may hang off any edge.                    */
+/*                                                                            */
+/******************************************************************************/
+	int i = 0, pg, x0, x1, p0, p1;
+
+	/* Clip to the display and convert to 0 based columns and pages */
+
+	x0 = (x < ORIGIN) ? 0 : x-ORIGIN;
+	x1 = (x+w-ORIGIN > COLUMNS) ? COLUMNS-1 : x+w-ORIGIN-1;
+	p0 = (y < ORIGIN) ? 0 : (y-ORIGIN)/ROWSPERPAGE;
+	p1 = (y+h-ORIGIN > ROWS) ? PAGES-1 : (y+h-ORIGIN-1)/ROWSPERPAGE;
+	if ((w < 1) || (h < 1) || (x0 > x1) || (p0 > p1)) return(0);
+
+	oledbatchbegin();
+	for (pg=p0; (pg <= p1) && (i == 0); pg++) {
+		i = oledsendfb(pi,fd,oled1106fb,pg,x0,x1-x0+1);
+	}
+	pg = oledbatchend();
+
+	return((i != 0) ? i : pg);                      // Error in pigpiod
+}
 
-		buf[0]=0x40;
-		for (colcount=0; colcount<COLUMNS; colcount++) {
-			buf[colcount+1]=oled1106fb[pgcount][colcount];
+int oledflushdiff(int pi, int fd, const char *fb, char *shadow) {
+/******************************************************************************/
+/*                                                                            */
+/* Bring the display up to date with the 1024 byte page-major image fb        */
+/* (NULL for the current framebuffer), given that shadow holds what the       */
+/* display shows now. On each page only the columns from the first to the     */
+/* last that differ are sent, in one write, and shadow is updated to match.   */
+/* The writes go to pigpiod as one batch. Returns the number of bytes of      */
+/* display data sent, or a pigpiod error - after which shadow no longer       */
+/* matches fb anywhere, so the next call sends everything.                    */
+/*                                                                            */
+/******************************************************************************/
+	int i = 0, pg, c0, c1, sent=0;
+
+	if (fb == NULL) fb = (const char *)oled1106fb;
+
+	oledbatchbegin();
+	for (pg=0; (pg < PAGES) && (i == 0); pg++) {
+		for (c0=0; (c0 < COLUMNS) && (fb[pg*COLUMNS+c0] == shadow[pg*COLUMNS+c0]); c0++);
+		if (c0 == COLUMNS) continue;                    // Page unchanged
+		for (c1=COLUMNS-1; fb[pg*COLUMNS+c1] == shadow[pg*COLUMNS+c1]; c1--);
+
+		i = oledsendfb(pi,fd,(const char (*)[128])fb,pg,c0,c1-c0+1);
+		memcpy(shadow+pg*COLUMNS+c0,fb+pg*COLUMNS+c0,c1-c0+1);
+		sent += c1-c0+1;
+	}
+	pg = oledbatchend();
+
+	// After an error the display's contents are unknown, so make every byte of
+	// the shadow differ from fb and the next call resends the whole image
+	if ((i != 0) || (pg != 0)) {
+		for (c0=0; c0<PAGES*COLUMNS; c0++) shadow[c0] = ~fb[c0];
+	}
+	return((i != 0) ? i : (pg != 0) ? pg : sent);
+}
+
+char *oledgetfb(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Return the address of the framebuffer currently used by the library.       */
+/* It is 1024 bytes, page-major: byte (page-1)*128+(x-1) holds the 8 pixels   */
+/* of column x on that page, bit 0 being the lowest row of the page.          */
+/*                                                                            */
+/******************************************************************************/
+
+	return((char *)oled1106fb);
+}
+
+void oledsetfb(char *fb) {
+/******************************************************************************/
+/*                                                                            */
+/* Make all subsequent drawing and flushing use the 1024 byte page-major      */
+/* buffer fb (for example a shared memory segment) instead of the library's   */
+/* own framebuffer. Passing NULL switches back to the library's framebuffer.  */
+/*                                                                            */
+/******************************************************************************/
+
+	oled1106fb = (fb == NULL) ? oledfbstore : (char (*)[128])fb;
+	return;
+}
+
+uint32_t oledutf8(const char **s) {
+/******************************************************************************/
+/*                                                                            */
+/* Decode the UTF-8 character at *s and step *s past it. Anything that isn't  */
+/* valid UTF-8 - a stray continuation byte, a sequence cut short, overlong or */
+/* for a surrogate or a code point beyond U+10FFFF - gives U+FFFD, one for    */
+/* each maximal part of a sequence as Unicode recommends, and decoding picks  */
+/* up again at the next byte that could start a character. Returns 0          */
+/* (without moving) at the end of the string.                                 */
+/*                                                                            */
+/******************************************************************************/
+	const uint8_t *p = (const uint8_t *)*s;
+	uint8_t lo = 0x80, hi = 0xBF;           // Allowed second byte
+	uint32_t c;
+	int i, n;
+
+	if (p[0] < 0x80) {
+		if (p[0] != 0) (*s)++;
+		return(p[0]);
+	}
+
+	if ((p[0] >= 0xC2) && (p[0] <= 0xDF)) n = 1;
+	else if ((p[0] >= 0xE0) && (p[0] <= 0xEF)) {
+		n = 2;
+		if (p[0] == 0xE0) lo = 0xA0;            // Overlong
+		if (p[0] == 0xED) hi = 0x9F;            // Surrogates
+	}
+	else if ((p[0] >= 0xF0) && (p[0] <= 0xF4)) {
+		n = 3;
+		if (p[0] == 0xF0) lo = 0x90;            // Overlong
+		if (p[0] == 0xF4) hi = 0x8F;            // Beyond U+10FFFF
+	}
+	else {                                  // Can't start a character
+		(*s)++;
+		return(0xFFFD);
+	}
+
+	c = p[0] & (0x3F >> n);
+	for (i=1; i<=n; i++) {
+		if ((p[i] < lo) || (p[i] > hi)) {       // Cut short
+			*s += i;
+			return(0xFFFD);
 		}
-        	i = i2c_write_device(pi,fd,buf,129);     		// Flush page to OLED
-		if (i !=0) return(i);                                   // Error in pigpiod
+		c = (c << 6) | (p[i] & 0x3F);
+		lo = 0x80;
+		hi = 0xBF;
 	}
 
-	return(0);
+	*s += n+1;
+	return(c);
+}
+
+int oledglyphfind(const uint32_t (*runs)[3], int nruns, uint32_t c, int *hint) {
+/******************************************************************************/
+/*                                                                            */
+/* Find code point c in a font's glyph index: runs of consecutive code        */
+/* points, each {first, count, glyph of first}, sorted by first code point.   */
+/* Returns the glyph number or -1 if the font hasn't got it. *hint is the run */
+/* the last lookup ended in, tried first as text mostly stays in one script;  */
+/* otherwise it is a binary search, so a font covering scattered code points  */
+/* needs neither a table per code point nor a search through every glyph.     */
+/*                                                                            */
+/******************************************************************************/
+	int lo = 0, hi = nruns, mid = *hint;
+
+	if ((mid >= 0) && (mid < nruns) && (c >= runs[mid][0]) && (c-runs[mid][0] < runs[mid][1]))
+		return(runs[mid][2]+c-runs[mid][0]);
+
+	while (lo < hi) {
+		mid = lo+(hi-lo)/2;
+		if (c < runs[mid][0]) hi = mid;
+		else if (c-runs[mid][0] >= runs[mid][1]) lo = mid+1;
+		else {
+			*hint = mid;
+			return(runs[mid][2]+c-runs[mid][0]);
+		}
+	}
+
+	return(-1);
+}
+
+uint32_t oledglyphfallback(uint32_t c) {
+/******************************************************************************/
+/*                                                                            */
+/* The character to show when a font hasn't got c: an accented Latin-1        */
+/* letter falls back to the letter without its accent, anything else to       */
+/* U+FFFD, U+FFFD to '?' and '?' to a space. A font without a space leaves a  */
+/* blank cell, so callers stop at the space.                                  */
+/*                                                                            */
+/******************************************************************************/
+	static const char base[] = "AAAAAAACEEEEIIIIDNOOOOO.OUUUUY.."        // U+00C0 - U+00DF
+	                           "aaaaaaaceeeeiiiidnooooo.ouuuuy.y";       // U+00E0 - U+00FF
+
+	if ((c >= 0xC0) && (c <= 0xFF) && (base[c-0xC0] != '.')) return((uint8_t)base[c-0xC0]);
+	if (c == 0xFFFD) return('?');
+	if (c == '?') return(' ');
+	return(0xFFFD);
+}
+
+static const uint8_t *oledglyph(uint32_t c, int *hint) {
+	// The 8x8 font's glyph (mirrored) for c, or for what it falls back to
+	int n;
+
+	if (c < 32) c = 32;                     // Control characters are spaces
+	for (;;) {
+		if (c < 128) return(oledf8x8[c-32]);
+		n = oledglyphfind(oledf8x8xruns, sizeof(oledf8x8xruns)/sizeof(oledf8x8xruns[0]), c, hint);
+		if (n >= 0) return(oledf8x8x[n]);
+		c = oledglyphfallback(c);       // Always ends at an ASCII character
+	}
+}
+
+static int oledrasterstr(const char *writebuf, char *buf) {
+/******************************************************************************/
+/*                                                                            */
+/* Unpack the glyphs of up to CHARSPERPAGE (16) characters of writebuf, which */
+/* is UTF-8, into buf as display columns, 8 per character. Control            */
+/* characters become spaces; characters the font hasn't got are drawn with    */
+/* the glyph oledglyphfallback() leads to. Returns the number of characters.  */
+/*                                                                            */
+/******************************************************************************/
+	const uint8_t *g;
+	int i, k, hint = 0;
+
+        /* Buffer is truncated to the page length if it is longer than 16 characters */
+
+        for (i=0; (i < CHARSPERPAGE) && *writebuf; i++) {
+		g = oledglyph(oledutf8(&writebuf), &hint);
+		for (k=0; k<8; k++) buf[(i*8)+k] = g[7-k];   // Glyphs are stored mirrored
+	}
+
+	return(i);
 }
 
 int oledstr(int pi, int fd, char *writebuf, uint8_t page, 
@@ -220,69 +784,215 @@ int oledstr(int pi, int fd, char *writebuf, uint8_t page,
 /*                                                                            */
 /* Write a string of up to CHARSPERPAGE (16) characters at the start of the   */
 /* specified page of the display. Page 8 = top page; page 1 = bottom page.    */
-/* Currently designed to work for the printing ASCII characters 32-127 only.  */
+/* The string is UTF-8. The font has the printing ASCII characters 32-127 and */
+/* a few symbols (e.g. degree, plus-minus, euro, arrows); accented Latin      */
+/* letters are shown without their accents and anything else as U+FFFD.       */
 /* Fontnum is for future development - can be used to specify an alternative  */
 /* font style for example.                                                    */
 /*                                                                            */
 /* (c) Tim Holyoake, 3rd May 2020.                                            */
 /*                                                                            */
 /******************************************************************************/
-	int i, len;
-        char buf[129];
-        char transbuf[16];
+	int len;
+        char buf[128];
 
      	/* Error handling - check page specified is in the range 1 - 8 */
 	/* and that a valid framebuffer option has been specified */
 
-        if (page < ORIGIN) {
-		olederror_fprintf(PAGETOOLOW);
-		return (PAGETOOLOW);
-	} else if (page > PAGES) {
-		olederror_fprintf(PAGETOOHIGH);
-		return (PAGETOOHIGH);
+	OLEDCHECK(page < ORIGIN, PAGETOOLOW);
+	OLEDCHECK(page > PAGES, PAGETOOHIGH);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite !=FBANDDISPLAY), INVALIDFBCODE);
+
+
+	len=oledrasterstr(writebuf,buf);
+
+ 	// Write the characters to the start of the page in the framebuffer 
+	memcpy(oled1106fb[page-ORIGIN],buf,len*8);
+
+	// Then to the display if requested - addressing and data in one write
+        if (fbwrite == FBANDDISPLAY) {
+		return(oledsendfb(pi,fd,oled1106fb,page-ORIGIN,0,len*8));
 	}
 
-        if ((fbwrite != FBONLY) && (fbwrite !=FBANDDISPLAY)) {
-		olederror_fprintf(INVALIDFBCODE);
-		return (INVALIDFBCODE);
+        return(0);
+}
+
+static struct oledtextrun *oledtextfind(const char *writebuf, uint8_t fontnum) {
+/******************************************************************************/
+/*                                                                            */
+/* Look a text run up in the cache, rasterising it into the least recently    */
+/* used slot on a miss. Either way the run becomes the most recently used.    */
+/*                                                                            */
+/******************************************************************************/
+	struct oledtextrun *r;
+	uint32_t h = 2166136261u;               // FNV-1a over the font and the text
+	const char *s;
+	int i, n, *link;
+
+	h = (h ^ fontnum) * 16777619u;
+	for (s=writebuf, i=0; (i < CHARSPERPAGE) && *s; i++) oledutf8(&s);   // Bytes in the
+	for (n=0; n<s-writebuf; n++)                                            // first 16
+		h = (h ^ (uint8_t)writebuf[n]) * 16777619u;                     // characters
+
+	for (i=oledtext.bucket[h % OLEDTEXTBUCKETS]; i >= 0; i=r->chain) {
+		r = &oledtext.run[i];
+		if ((r->hash == h) && (r->font == fontnum) && (r->keylen == n) &&
+		    (memcmp(r->key, writebuf, n) == 0)) {
+			oledtext.hits++;
+			break;
+		}
 	}
 
-	if (fbwrite == FBANDDISPLAY) {
-        	buf[0]=0x00;                                // Set up the page to be written
-        	buf[1]=COLOFFSET;                           // if write to display selected
-        	buf[2]=0x10;
-        	buf[3]=0xB0+(page-ORIGIN);
-       		i = i2c_write_device(pi,fd,buf,4);                                 
+	if (i < 0) {
+		/* Miss - take the least recently used slot (the tail) and unhook it */
+		/* from its hash chain if it was in use                              */
+
+		oledtext.misses++;
+		i = oledtext.tail;
+		r = &oledtext.run[i];
+		if (r->len >= 0) {
+			for (link=&oledtext.bucket[r->hash % OLEDTEXTBUCKETS]; *link != i; link=&oledtext.run[*link].chain);
+			*link = r->chain;
+		}
+		r->hash = h;
+		r->font = fontnum;
+		memcpy(r->key, writebuf, n);
+		r->keylen = n;
+		r->len = oledrasterstr(writebuf, r->bits);
+		r->chain = oledtext.bucket[h % OLEDTEXTBUCKETS];
+		oledtext.bucket[h % OLEDTEXTBUCKETS] = i;
 	}
 
-        /* Buffer is truncated to the page length if it is longer than 16 characters */
+	/* Move to the head of the LRU list */
+
+	if (oledtext.head != i) {
+		if (r->newer >= 0) oledtext.run[r->newer].older = r->older;
+		if (r->older >= 0) oledtext.run[r->older].newer = r->newer;
+		else oledtext.tail = r->newer;
+		r->older = oledtext.head;
+		r->newer = -1;
+		oledtext.run[oledtext.head].newer = i;
+		oledtext.head = i;
+	}
+
+	return(r);
+}
+
+int oledstrcached(int pi, int fd, char *writebuf, uint8_t page,
+                  uint8_t fontnum, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* The same as oledstr(), but the rasterised text is kept in a cache of the   */
+/* OLEDTEXTCACHE most recently used runs, keyed by string and font. Labels    */
+/* drawn every frame then cost a hash and a single memcpy into the page.      */
+/* Use oledtextcachestats() to see how well the cache is doing.               */
+/*                                                                            */
+/******************************************************************************/
+	struct oledtextrun *r;
+
+	OLEDCHECK(page < ORIGIN, PAGETOOLOW);
+	OLEDCHECK(page > PAGES, PAGETOOHIGH);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite !=FBANDDISPLAY), INVALIDFBCODE);
+
+	if (oledtext.head < 0) oledtextcacheclear();
+
+	r = oledtextfind(writebuf, fontnum);
+	memcpy(oled1106fb[page-ORIGIN], r->bits, r->len*8);
 
-	len=strlen(writebuf);
-	if (len > CHARSPERPAGE) len=CHARSPERPAGE;
-        strncpy(transbuf,writebuf,len);
-
-        buf[0]=0x40;				    
-        for (i=0; i<len; i++) {                     
-		if (((uint8_t)transbuf[i]<32) || ((uint8_t)transbuf[i]>127)) transbuf[i]=32;
-        	buf[(i*8)+1]=oledf8x8[transbuf[i]-32][7];     
-        	buf[(i*8)+2]=oledf8x8[transbuf[i]-32][6];     
-        	buf[(i*8)+3]=oledf8x8[transbuf[i]-32][5];
-    		buf[(i*8)+4]=oledf8x8[transbuf[i]-32][4];
-        	buf[(i*8)+5]=oledf8x8[transbuf[i]-32][3];
-        	buf[(i*8)+6]=oledf8x8[transbuf[i]-32][2];
-        	buf[(i*8)+7]=oledf8x8[transbuf[i]-32][1];
-        	buf[(i*8)+8]=oledf8x8[transbuf[i]-32][0];
-	}
-   
         if (fbwrite == FBANDDISPLAY) {
-       		i = i2c_write_device(pi,fd,buf,1+(len*8));        // Write contents of buf to oled 
-	}							  // if write to display selected
+		return(oledsendfb(pi,fd,oled1106fb,page-ORIGIN,0,r->len*8));
+	}
 
- 	// Write the page to the framebuffer 
-	for (i=1; i<1+(len*8); i++)
-		oled1106fb[page-ORIGIN][i]=buf[i]; 
+	return(0);
+}
 
-        return(0);
+void oledtextcacheclear(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Empty the text run cache and zero its statistics.                          */
+/*                                                                            */
+/******************************************************************************/
+	int i;
+
+	for (i=0; i<OLEDTEXTBUCKETS; i++) oledtext.bucket[i] = -1;
+	for (i=0; i<OLEDTEXTCACHE; i++) {
+		oledtext.run[i].len = -1;               // Slot unused
+		oledtext.run[i].newer = i-1;
+		oledtext.run[i].older = (i+1 < OLEDTEXTCACHE) ? i+1 : -1;
+	}
+	oledtext.head = 0;
+	oledtext.tail = OLEDTEXTCACHE-1;
+	oledtext.hits = 0;
+	oledtext.misses = 0;
+	return;
+}
+
+double oledtextcachestats(long *hits, long *misses) {
+/******************************************************************************/
+/*                                                                            */
+/* Return the text run cache's hit rate (0.0 to 1.0) since it was last        */
+/* cleared, and the raw hit and miss counts if hits and misses aren't NULL.   */
+/*                                                                            */
+/******************************************************************************/
+
+	if (hits != NULL) *hits = oledtext.hits;
+	if (misses != NULL) *misses = oledtext.misses;
+	return((oledtext.hits+oledtext.misses) ? (double)oledtext.hits/(oledtext.hits+oledtext.misses) : 0.0);
+}
+
+static void oledexpandinit(void) {
+	// Fill the bit expansion tables for 2x, 3x and 4x text
+	uint32_t e;
+	int k, b, i;
+
+	for (k=2; k<=4; k++) {
+		for (b=0; b<256; b++) {
+			for (i=0, e=0; i<8; i++) if (b & (0x01 << i)) e |= ((1u << k)-1) << (i*k);
+			oledexpand[k-2][b] = e;
+		}
+	}
+}
+
+int oledstrscaled(int pi, int fd, const char *s, int scale, int x, int y,
+                  uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Write s (UTF-8) in the 8x8 font scaled up scale (1 to 4) times, with the   */
+/* bottom left of the first character cell at (x,y), which may be any pixel.  */
+/* Each glyph column is made scale pages tall with one table lookup and       */
+/* repeated scale times across, and the cell drawn with oledbitmap() - so it  */
+/* is shifted into place the same way and mode works the same way: PIXON      */
+/* sets the text's pixels and leaves the rest, so clear a changing readout    */
+/* first (or draw the old value again with PIXOFF). Text running off the      */
+/* display is clipped. Returns 0, BADIMAGE for a bad scale, BADPIXELCMD,      */
+/* INVALIDFBCODE or a pigpiod error.                                          */
+/*                                                                            */
+/******************************************************************************/
+	uint8_t cell[4*32];                     // Up to 4 pages of 32 columns
+	const uint8_t *g;
+	uint32_t e;
+	int i, k, p, r, w = 8*scale, x0 = x, hint = 0;
+
+	OLEDCHECK((scale < 1) || (scale > 4), BADIMAGE);
+	OLEDCHECK(mode > PIXINV, BADPIXELCMD);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	if (scale > 1) pthread_once(&oledexpandonce, oledexpandinit);
+
+	for (; *s && (x < COLUMNS+ORIGIN); x+=w) {
+		g = oledglyph(oledutf8(&s), &hint);
+		for (k=0; k<8; k++) {
+			e = (scale == 1) ? g[7-k] : oledexpand[scale-2][g[7-k]];   // Glyphs are mirrored
+			for (p=0; p<scale; p++)
+				for (r=0; r<scale; r++) cell[p*w+k*scale+r] = (uint8_t)(e >> (8*p));
+		}
+		i = oledbitmap(pi,fd,cell,w,w,x,y,mode,FBONLY);
+		if (i != 0) return(i);
+	}
+
+	if (fbwrite == FBANDDISPLAY) return(oledflushrect(pi,fd,x0,y,x-x0,w));
+
+	return(0);
 }
 
 int oledclear(int pi, int fd, uint8_t fbwrite) {
@@ -295,38 +1005,15 @@ int oledclear(int pi, int fd, uint8_t fbwrite) {
 /* (c) Tim Holyoake, 25th April 2020.                                         */
 /*                                                                            */
 /******************************************************************************/
-	int i,count,col;
-        char buf[4];
-        char blankpage[129]=   {0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+	int i,count;
+        static const char blankpage[COLUMNS];	// 128 bytes of 0x00
 
         for (count=0; count<PAGES; count++) {            // Loop through pages 0xB0 to 0xB7
-        	buf[0]=0x00;
-                buf[1]=COLOFFSET;
-                buf[2]=0x10;
-        	buf[3]=0xB0+count;
 		if (fbwrite == FBANDDISPLAY) {			    // Blank display on request
-        		i = i2c_write_device(pi,fd,buf,4);          // Set page to be blanked
-			if (i !=0) return(i);			    // pigpiod error
-        		i = i2c_write_device(pi,fd,blankpage,129);  // Write blank page to OLED
+        		i = oledsendcols(pi,fd,count,0,blankpage,COLUMNS);
 			if (i !=0) return(i);			    // pigpiod error
 		}
-                for (col=0; col<COLUMNS; col++)       		    // Clear the framebuffer
-           		oled1106fb[count][col]=0x00;
+		memset(oled1106fb[count],0x00,COLUMNS);	    // Clear the framebuffer
 	}
 
         return(0);
@@ -348,14 +1035,14 @@ int oledinit(int pi, int fd) {
         buf[1] =0xAE;			// Turn the OLED display off.
         buf[2] =0x81;                   // Set the display contrast ...
 	buf[3] =0x80;                   // ... to the default (middle) value 0x80.
-	buf[4] =0xA1;			// Set segment re-map. (A0 default, A1 reversed).
+	buf[4] =oledsegremap();		// Set segment re-map. (A0 default, A1 reversed).
 	buf[5] =0xA6;			// Set display to normal video (0xA7 is reverse video).
         buf[6] =0xA8;			// Set multiplex display ratio ...
         buf[7] =0x3F;                   // ... to 3F - i.e. use all 64 lines of the display.
         buf[8] =0xAD;                   // Set the DC-DC converter ...
         buf[9] =0x8B;                   // ... to ON (built-in)
         buf[10]=0x30;                   // Set the pump charger voltage to 6.4volts
-        buf[11]=0xC0;                   // Set common output scan direction (C0 default, C8 reversed).
+        buf[11]=oledcomscan();          // Set common output scan direction (C0 default, C8 reversed).
         buf[12]=0xD3;			// Set display offset mode ...
         buf[13]=0x00;                   // ... to 0x00 (i.e. no offest).
         buf[14]=0xD5;                   // Divide ratio / osciallator frequency is set to ...
@@ -367,7 +1054,7 @@ int oledinit(int pi, int fd) {
         buf[20]=0xDB;                   // Set VCOM deselect level to ...
         buf[21]=0x40;                   // ... 0x40 = 1volt (any value between 0x40 and 0xFF has the same effect).
 
-        i=i2c_write_device(pi,fd,buf,22); // Ignore any pigpiod errors for the moment ...
+        i=oledwrite(pi,fd,buf,22); // Ignore any pigpiod errors for the moment ...
 
         oledclear(pi,fd,FBANDDISPLAY);  // Clear the display RAM
         buf[0] =0x00;                   // Set the SH1106 to recieve commands.
@@ -376,11 +1063,62 @@ int oledinit(int pi, int fd) {
         buf[3] =0x40;			// Set the display start line to 0x40.
         buf[4] =0xAF;                   // Turn the OLED display on now initialization is complete.
 
-        i=i2c_write_device(pi,fd,buf,5);
+        i=oledwrite(pi,fd,buf,5);
 
         return(i);
 }
 	
+int oledrotate(int pi, int fd, uint8_t rotation, uint8_t mirror) {
+/******************************************************************************/
+/*                                                                            */
+/* Set the orientation of the display: rotation is OLEDROT0, OLEDROT90,       */
+/* OLEDROT180 or OLEDROT270 (clockwise) and mirror any of OLEDMIRRORX (left   */
+/* to right) and OLEDMIRRORY (top to bottom). Drawing is unchanged - the      */
+/* framebuffer is still 128x64 with (1,1) bottom left - and the display is    */
+/* redrawn from it in the new orientation. 180 degrees and the mirrors cost   */
+/* nothing as the SH1106 does them. At 90 and 270 degrees the framebuffer is  */
+/* turned as it is flushed and only the square from x=33 to x=96 fits on the  */
+/* display; it is shown in the middle with the rest of the display blank.     */
+/*                                                                            */
+/******************************************************************************/
+	int i, page;
+	char buf[3];
+	static const char blankpage[COLUMNS];
+
+	/* Error handling - check rotation and mirror are valid */
+
+	OLEDCHECK((rotation > OLEDROT270) || (mirror & ~(OLEDMIRRORX | OLEDMIRRORY)), BADORIENTATION);
+
+	oledrotation = rotation;
+	oledmirror = mirror;
+
+	buf[0]=0x00;
+	buf[1]=oledsegremap();
+	buf[2]=oledcomscan();
+	i = oledwrite(pi,fd,buf,3);
+	if (i != 0) return(i);                          // Error in pigpiod
+
+	// The margins either side of a turned image must be blanked first
+	if ((rotation == OLEDROT90) || (rotation == OLEDROT270)) {
+		for (page=0; page<PAGES; page++) {
+			i = oledsendcols(pi,fd,page,0,blankpage,COLUMNS);
+			if (i != 0) return(i);
+		}
+	}
+
+	return(oledflushfb(pi,fd));
+}
+
+uint8_t oledgetrotation(void) {
+/******************************************************************************/
+/*                                                                            */
+/* Return the rotation last set by oledrotate() (OLEDROT0 to OLEDROT270).     */
+/*                                                                            */
+/******************************************************************************/
+
+	return(oledrotation);
+}
+
 int oledoff(int pi, int fd) {
 /******************************************************************************/
 /*                                                                            */
@@ -393,7 +1131,7 @@ int oledoff(int pi, int fd) {
 /******************************************************************************/
 	char buf[2] = {0x00, 0xAE};
 
-        return(i2c_write_device(pi,fd,buf,2));
+        return(oledwrite(pi,fd,buf,2));
 }
 
 int oledon(int pi, int fd) {
@@ -408,7 +1146,7 @@ int oledon(int pi, int fd) {
 /******************************************************************************/
 	char buf[2] = {0x00, 0xAF};
 
-        return(i2c_write_device(pi,fd,buf,2));
+        return(oledwrite(pi,fd,buf,2));
 }
 
 int oledrv(int pi, int fd) {
@@ -423,7 +1161,7 @@ int oledrv(int pi, int fd) {
 /******************************************************************************/
 	char buf[2] = {0x00, 0xA7};
 
-        return(i2c_write_device(pi,fd,buf,2));
+        return(oledwrite(pi,fd,buf,2));
 }
 
 int olednv(int pi, int fd) {
@@ -438,7 +1176,7 @@ int olednv(int pi, int fd) {
 /******************************************************************************/
 	char buf[2] = {0x00, 0xA6};
 
-        return(i2c_write_device(pi,fd,buf,2));
+        return(oledwrite(pi,fd,buf,2));
 }
 
 int oledsetpage(int pi, int fd, int pageno) {
@@ -457,26 +1195,16 @@ int oledsetpage(int pi, int fd, int pageno) {
 
 	/* Error handlling - check pageno is in range 1 - 8 */
 
-        if (pageno < 1) {
-                olederror_fprintf(PAGETOOLOW);
-		return (PAGETOOLOW);
-	}
-
-        else if (pageno > 8) {
-                olederror_fprintf(PAGETOOHIGH);
-		return (PAGETOOHIGH);
-	}
+	OLEDCHECK(pageno < 1, PAGETOOLOW);
+	OLEDCHECK(pageno > 8, PAGETOOHIGH);
 
 	/* Set the active page */
 
-        else {
-		buf[0]=0x00;
-		buf[1]=0xB0+pageno-1;
-        	i = i2c_write_device(pi,fd,buf,2);
-        	return(i);
-	}
+	buf[0]=0x00;
+	buf[1]=0xB0+pageno-1;
+        i = oledwrite(pi,fd,buf,2);
 
-	return(0);
+	return(i);
 }
 
 int oledresetcol(int pi, int fd) {
@@ -490,7 +1218,7 @@ int oledresetcol(int pi, int fd) {
 /******************************************************************************/
 	char buf[3] = {0x00, COLOFFSET, 0x10};
 
-       	return(i2c_write_device(pi,fd,buf,3));
+       	return(oledwrite(pi,fd,buf,3));
 }
 
 int oledresetline(int pi, int fd) {
@@ -504,7 +1232,25 @@ int oledresetline(int pi, int fd) {
 /******************************************************************************/
 	char buf[2] = {0x00, 0x40};
 
-       	return(i2c_write_device(pi,fd,buf,2));
+       	return(oledwrite(pi,fd,buf,2));
+}
+
+int oledstartline(int pi, int fd, int line) {
+/******************************************************************************/
+/*                                                                            */
+/* Set the display start line - the display RAM row (0-63) shown on the       */
+/* bottom row of the display. Rows above it follow on, wrapping from 63 back  */
+/* to 0, so this scrolls the whole display vertically without sending any     */
+/* display data. Requires the command code 0x00 followed by 0x40+line.        */
+/*                                                                            */
+/******************************************************************************/
+	char buf[2];
+
+	OLEDCHECK((line < 0) || (line > ROWS-1), ROWOUTOFRANGE);
+
+	buf[0]=0x00;
+	buf[1]=0x40+line;
+       	return(oledwrite(pi,fd,buf,2));
 }
 
 int oledhorizline(int pi, int fd, uint8_t startx, 
@@ -525,25 +1271,14 @@ int oledhorizline(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, startx+xlen, starty and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx+xlen > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx+xlen > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty > ROWS), ROWOUTOFRANGE);
 
 	/* Draw the line */
 
 	for (i=startx; i<=startx+xlen; i++) 
-		oledsetpixel(pi,fd,i,starty,mode,FBONLY);
+		oledplot(i,starty,mode);
 
 	/* Flush to display if this is required */
 
@@ -570,25 +1305,14 @@ int oledvertline(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, starty, starty+ylen and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty+ylen > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty+ylen > ROWS), ROWOUTOFRANGE);
 
 	/* Draw the line */
 
 	for (i=starty; i<=starty+ylen; i++)
-		oledsetpixel(pi,fd,startx,i,mode,FBONLY);
+		oledplot(startx,i,mode);
 
 	/* Flush to display if this is required */
 
@@ -618,31 +1342,20 @@ int oledrectangle(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, startx+xlen, starty, starty+ylen and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx+xlen > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty+ylen > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx+xlen > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty+ylen > ROWS), ROWOUTOFRANGE);
 
 	/* Draw the four sides of the rectangle bottom left -> bottom right -> top right -> top left -> bottom left */
 
 	for (i=startx; i<startx+xlen; i++)
-		oledsetpixel(pi,fd,i,starty,mode,FBONLY);
+		oledplot(i,starty,mode);
         for (i=starty;i<starty+ylen; i++)
-		oledsetpixel(pi,fd,startx+xlen,i,mode,FBONLY);
+		oledplot(startx+xlen,i,mode);
 	for (i=startx+xlen; i>startx; i--)
-		oledsetpixel(pi,fd,i,starty+ylen,mode,FBONLY);
+		oledplot(i,starty+ylen,mode);
 	for (i=starty+ylen; i>starty; i--)
-		oledsetpixel(pi,fd,startx,i,mode,FBONLY);
+		oledplot(startx,i,mode);
 
 	/* Flush to display if this is required */
 
@@ -670,26 +1383,15 @@ int oledfillrect(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, startx+xlen, starty, starty+ylen and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx+xlen > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty+ylen > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx+xlen > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty+ylen > ROWS), ROWOUTOFRANGE);
 
 	/* Draw the filled rectangle from the bottom line upwards */
 
 	for (y=starty; y<=starty+ylen; y++) {
 		for (x=startx; x<=startx+xlen; x++)
-			oledsetpixel(pi,fd,x,y,mode,FBONLY);
+			oledplot(x,y,mode);
 	}
 
 	/* Flush to display if this is required */
@@ -721,25 +1423,10 @@ int oledcircle(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, starty, r and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
-
-        if (r < 1) {
-		olederror_fprintf(NEGORZERORADIUS);
-		return(NEGORZERORADIUS);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty > ROWS), ROWOUTOFRANGE);
+	OLEDCHECK(r < 1, NEGORZERORADIUS);
 
 	/* Draw the circle */
 
@@ -761,7 +1448,7 @@ int oledcircle(int pi, int fd, uint8_t startx,
 				} 
 				else {
 					// A new pixel needs to be set
-					oledsetpixel(pi,fd,startx+x,starty+y,mode,FBONLY);
+					oledplot(startx+x,starty+y,mode);
 				}
 			}
 		}
@@ -796,25 +1483,10 @@ int oledfillcircle(int pi, int fd, uint8_t startx,
 
 	/* Error handling - check startx, starty, r and mode parameters are in range */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((startx < ORIGIN) || (startx > COLUMNS)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((starty < ORIGIN) || (starty > ROWS)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
-
-        if (r < 1) {
-		olederror_fprintf(NEGORZERORADIUS);
-		return(NEGORZERORADIUS);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((startx < ORIGIN) || (startx > COLUMNS), COLOUTOFRANGE);
+	OLEDCHECK((starty < ORIGIN) || (starty > ROWS), ROWOUTOFRANGE);
+	OLEDCHECK(r < 1, NEGORZERORADIUS);
 
 	/* Draw the filled circle */
 
@@ -831,7 +1503,7 @@ int oledfillcircle(int pi, int fd, uint8_t startx,
 				} 
 				else {
 					// A new pixel needs to be set
-					oledsetpixel(pi,fd,startx+x,starty+y,mode,FBONLY);
+					oledplot(startx+x,starty+y,mode);
 				}
 			}
 		}
@@ -844,6 +1516,159 @@ int oledfillcircle(int pi, int fd, uint8_t startx,
 	return(0);
 }
 
+struct oledpolyedge {
+	int64_t ymin, ymax;             // Scanlines the edge crosses, ymin <= y < ymax
+	int64_t x, dx;                  // x at the current scanline and per scanline, 16.16
+	int64_t x0, x1;                 // x at ymin and ymax
+};
+
+static inline int64_t oledclamp(int64_t v, int64_t lo, int64_t hi) {
+	return((v < lo) ? lo : (v > hi) ? hi : v);
+}
+
+int oledfillpoly(int pi, int fd, const int *xy, int n, uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Draws a filled polygon with n vertices (3 to OLEDMAXPOLY) given as x,y     */
+/* pairs in xy. It may be concave or cross itself (even-odd rule) and hang    */
+/* off any edge of the display. Vertices are the corners of pixels, so pixel  */
+/* (x,y) is filled when its centre (x+0.5,y+0.5) is inside: the triangle      */
+/* (1,1) (11,1) (1,11) fills 45 pixels, and polygons sharing an edge never    */
+/* both fill the pixels along it, which keeps PIXINV tilings clean.           */
+/* Mode is any of PIXON, PIXOFF or PIXINV.                                    */
+/*                                                                            */
+/* Edges go into a table sorted by their lowest scanline. Moving up the       */
+/* display, edges join an active list as they start and leave as they end,    */
+/* and each steps its x by a fixed point slope. The active edges, in x order, */
+/* pair up into spans, clipped to the display and written through a column    */
+/* mask a page at a time. Edges are stepped in 64 bits, so any int vertex     */
+/* works, however far off the display.                                        */
+/*                                                                            */
+/******************************************************************************/
+	struct oledpolyedge edge[OLEDMAXPOLY], *active[OLEDMAXPOLY], *e, t;
+	uint8_t mask[COLUMNS];
+	int i, j, k, y, ylo, yhi, page, c0=COLUMNS, c1=-1;
+	int nedges=0, nactive=0, next=0;
+	int64_t x0, y0, x1, y1, v, minx, maxx, miny, maxy;
+	double d;
+
+	/* Error handling - check mode, fbwrite and vertex count */
+
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+	OLEDCHECK((xy == NULL) || (n < 3) || (n > OLEDMAXPOLY), BADPOLYGON);
+
+	/* Build the edge table (0 based co-ordinates), leaving out horizontal */
+	/* edges, which never cross a pixel centre line.                       */
+
+	minx = maxx = xy[0];
+	miny = maxy = xy[1];
+	for (i=0; i<n; i++) {
+		j = (i+1) % n;
+		x0 = (int64_t)xy[2*i]-ORIGIN;  y0 = (int64_t)xy[2*i+1]-ORIGIN;
+		x1 = (int64_t)xy[2*j]-ORIGIN;  y1 = (int64_t)xy[2*j+1]-ORIGIN;
+		if (xy[2*i] < minx) minx = xy[2*i];
+		if (xy[2*i] > maxx) maxx = xy[2*i];
+		if (xy[2*i+1] < miny) miny = xy[2*i+1];
+		if (xy[2*i+1] > maxy) maxy = xy[2*i+1];
+		if (y0 == y1) continue;
+		if (y0 > y1) {
+			v = x0; x0 = x1; x1 = v;
+			v = y0; y0 = y1; y1 = v;
+		}
+		e = &edge[nedges++];
+		e->ymin = y0;
+		e->ymax = y1;
+		e->dx = (x1-x0)*65536/(y1-y0);
+		e->x = x0*65536+e->dx/2;                // x at the first centre line, y0+0.5
+		e->x0 = x0;
+		e->x1 = x1;
+	}
+
+	for (i=1; i<nedges; i++) {                      // Sort by lowest scanline
+		t = edge[i];
+		for (j=i; (j > 0) && (edge[j-1].ymin > t.ymin); j--) edge[j] = edge[j-1];
+		edge[j] = t;
+	}
+
+	/* Only the scanlines on the display are visited */
+
+	ylo = (int)oledclamp(miny-ORIGIN,0,ROWS);
+	yhi = (int)oledclamp(maxy-ORIGIN,0,ROWS);
+	memset(mask,0,sizeof(mask));
+	page = ylo/ROWSPERPAGE;
+
+	for (y=ylo; y<yhi; y++) {
+		if (y/ROWSPERPAGE != page) {
+			oledspanflush(page,mask,mode,&c0,&c1);
+			page = y/ROWSPERPAGE;
+		}
+
+		// Drop edges that have ended, then add those that start here (or
+		// started below the display, stepped on to this scanline).
+		for (i=k=0; i<nactive; i++)
+			if (active[i]->ymax > y) active[k++] = active[i];
+		nactive = k;
+		while ((next < nedges) && (edge[next].ymin <= y)) {
+			e = &edge[next++];
+			if (e->ymax <= y) continue;
+			// Stepping up from far below the display would add up the error
+			// in dx, so an edge starting below it is put at its exact x
+			if (y > e->ymin) {
+				d = (e->x0+(double)(e->x1-e->x0)*(y-e->ymin+0.5)/(e->ymax-e->ymin))*65536.0;
+				e->x = (int64_t)d;
+				if (e->x > d) --e->x;   // Round down, not towards zero
+			}
+			active[nactive++] = e;
+		}
+
+		// Keep the active list in x order - it is nearly sorted already
+		for (i=1; i<nactive; i++) {
+			e = active[i];
+			for (j=i; (j > 0) && (active[j-1]->x > e->x); j--) active[j] = active[j-1];
+			active[j] = e;
+		}
+
+		// Fill the pixels whose centres lie between each pair of edges
+		for (i=0; i+1<nactive; i+=2)
+			oledspan(mask,(int)oledclamp((active[i]->x+0x7FFF) >> 16,-1,COLUMNS),
+			         (int)oledclamp((active[i+1]->x+0x7FFF) >> 16,-1,COLUMNS)-1,
+			         0x01 << (y%ROWSPERPAGE),&c0,&c1);
+
+		for (i=0; i<nactive; i++) active[i]->x += active[i]->dx;
+	}
+	oledspanflush(page,mask,mode,&c0,&c1);
+
+	/* Flush the polygon's bounding box to display if this is required */
+
+	if (fbwrite == FBANDDISPLAY) {
+		minx = oledclamp(minx,ORIGIN,COLUMNS+ORIGIN);   // Clipped first so the
+		maxx = oledclamp(maxx,ORIGIN,COLUMNS+ORIGIN);   // size fits in an int
+		miny = oledclamp(miny,ORIGIN,ROWS+ORIGIN);
+		maxy = oledclamp(maxy,ORIGIN,ROWS+ORIGIN);
+		return(oledflushrect(pi,fd,(int)minx,(int)miny,(int)(maxx-minx),(int)(maxy-miny)));
+	}
+
+	return(0);
+}
+
+int oledfilltri(int pi, int fd, int x0, int y0, int x1, int y1, int x2, int y2,
+                uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Draws a filled triangle with corners (x0,y0), (x1,y1) and (x2,y2), using   */
+/* the same rules as oledfillpoly().                                          */
+/*                                                                            */
+/******************************************************************************/
+	int xy[6];
+
+	xy[0] = x0; xy[1] = y0;
+	xy[2] = x1; xy[3] = y1;
+	xy[4] = x2; xy[5] = y2;
+
+	return(oledfillpoly(pi,fd,xy,3,mode,fbwrite));
+}
+
 int oledsetpixel(int pi, int fd, uint8_t x, uint8_t y, uint8_t mode, 
                  uint8_t fbwrite) {
 /******************************************************************************/
@@ -869,69 +1694,87 @@ int oledsetpixel(int pi, int fd, uint8_t x, uint8_t y, uint8_t mode,
 /* (c) Tim Holyoake, 1st May 2020.                                            */
 /*                                                                            */
 /******************************************************************************/
-	int i;
+	int i=0;
 	uint8_t col, page;
-	char buf[4];
 
 	/* Error handling - check x,y,mode and fbwrite parameters are ok */
 
-        if ((mode < PIXOFF) || (mode > PIXINV)) {
-		olederror_fprintf(BADPIXELCMD);
-		return(BADPIXELCMD);
-	} 
-
-        if ((x < ORIGIN) || (x > COLUMNS+ORIGIN-1)) {
-		olederror_fprintf(COLOUTOFRANGE);
-		return(COLOUTOFRANGE);
-	}
-
-	if ((y < ORIGIN) || (y > ROWS+ORIGIN-1)) {
-		olederror_fprintf(ROWOUTOFRANGE);
-		return(ROWOUTOFRANGE);
-	}
-
-        if ((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY)) {
-		olederror_fprintf(INVALIDFBCODE);
-		return(INVALIDFBCODE);
-	}
+	OLEDCHECK((mode < PIXOFF) || (mode > PIXINV), BADPIXELCMD);
+	OLEDCHECK((x < ORIGIN) || (x > COLUMNS+ORIGIN-1), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y > ROWS+ORIGIN-1), ROWOUTOFRANGE);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
 
 	/* locate the column (0-127) and page (0-7) on the display for the pixel */
 
         col = x-ORIGIN;
         page = (y-ORIGIN)/ROWSPERPAGE;
 
-	/* set the display to the correct column (with offest) and page */
-	if (fbwrite == FBANDDISPLAY) {
-		buf[0] = 0x00;
- 		buf[1] = (col+COLOFFSET) & 0x0F;
-        	buf[2] = 0x10 | (((col+COLOFFSET) & 0xF0 ) >> 4);
-        	buf[3] = 0xB0+page;
-       		i = i2c_write_device(pi,fd,buf,4);
-		// If an error was detected in pigpiod return immediately.
-        	if (i != 0) return(i);		    
-	}
-
         // Read the framebuffer, perform the correct operation for the specific
         // pixel required of the 8 (ON, OFF or INVERT), update the framebuffer
-        // then finally update the display if required.
+        // then finally update the display if required, setting the column and
+        // page and writing the byte in the same transaction.
 
-	if (mode == PIXON) {
-		buf[1]=oled1106fb[page][col]|(0x01 << (y-ORIGIN)%ROWSPERPAGE);
-                oled1106fb[page][col]=buf[1];
-	}
-	else if (mode == PIXOFF) {
-		buf[1]=oled1106fb[page][col]&(~(0x01 << (y-ORIGIN)%ROWSPERPAGE));
-                oled1106fb[page][col]=buf[1];
-	}
-        else {  // assume mode is PIXINV
-		buf[1]=oled1106fb[page][col]^(0x01 << (y-ORIGIN)%ROWSPERPAGE);
-                oled1106fb[page][col]=buf[1];
-	}
+	oledpixop(&oled1106fb[page][col],0x01 << (y-ORIGIN)%ROWSPERPAGE,mode);
 
 	if (fbwrite == FBANDDISPLAY) {
-		buf[0]=0x40;
-       		i = i2c_write_device(pi,fd,buf,2);	// Update the oled if requested
+		i = oledsendfb(pi,fd,oled1106fb,page,col,1);
 	}
 
 	return(i);
 }
+
+int oledbitmap(int pi, int fd, const uint8_t *bits, int w, int h,
+               int x, int y, uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Draws a w x h pixel bitmap with its bottom left corner at (x,y). The       */
+/* bitmap is in the same page-major layout as the framebuffer: (h+7)/8 pages  */
+/* of w bytes, page 0 first, bit 0 of each byte the lowest row of its page.   */
+/* Mode PIXON sets the display pixels under the bitmap's set bits, PIXOFF     */
+/* clears them and PIXINV inverts them; clear bits leave the display alone.   */
+/* The bitmap may hang off any edge of the display and is clipped. Each byte  */
+/* is shifted into the one or two framebuffer pages it straddles, so a bitmap */
+/* costs about the same wherever it is placed vertically.                     */
+/*                                                                            */
+/******************************************************************************/
+	int sp, c, col, r0, dp, shift, c0, c1;
+	uint8_t b, lastmask, lo, hi;
+
+	/* Error handling - check mode and fbwrite parameters are ok */
+
+	OLEDCHECK(mode > PIXINV, BADPIXELCMD);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	if ((bits == NULL) || (w < 1) || (h < 1)) return(0);
+
+	/* Only the columns that land on the display are visited */
+
+	c0 = (x < ORIGIN) ? ORIGIN-x : 0;
+	c1 = (x+w-ORIGIN > COLUMNS) ? COLUMNS-x+ORIGIN : w;
+	lastmask = (h % ROWSPERPAGE) ? (0x01 << (h % ROWSPERPAGE))-1 : 0xFF;
+
+	for (sp=0; sp<(h+ROWSPERPAGE-1)/ROWSPERPAGE; sp++) {
+		r0 = y-ORIGIN+sp*ROWSPERPAGE;           // Display row of bit 0
+		dp = (r0 >= 0) ? r0/ROWSPERPAGE : -((ROWSPERPAGE-1-r0)/ROWSPERPAGE);
+		shift = r0-dp*ROWSPERPAGE;
+		if ((dp >= PAGES) || (dp < -1)) continue;
+
+		for (c=c0; c<c1; c++) {
+			b = bits[sp*w+c];
+			if (sp == (h-1)/ROWSPERPAGE) b &= lastmask;
+			if (b == 0) continue;
+			col = x-ORIGIN+c;
+
+			lo = (uint8_t)(b << shift);
+			hi = shift ? (uint8_t)(b >> (ROWSPERPAGE-shift)) : 0;
+			if ((dp >= 0) && (lo != 0)) oledpixop(&oled1106fb[dp][col],lo,mode);
+			if ((dp+1 < PAGES) && (hi != 0)) oledpixop(&oled1106fb[dp+1][col],hi,mode);
+		}
+	}
+
+	/* Flush to display if this is required */
+
+	if (fbwrite == FBANDDISPLAY) return(oledflushrect(pi,fd,x,y,w,h));
+
+	return(0);
+}
@@ -3,29 +3,123 @@
 /* Header file for                                                            */
 /* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
 /* Writen for a Raspberry Pi 3B+ using the Raspbian Buster operating system.  */
-/* Prerequisite: PIGPIOD must be installed and running.                       */
+/* Prerequisite: PIGPIOD must be installed and running (unless built with     */
+/* -DOLEDNOPIGPIO, when the display is reached only through a transport set   */
+/* by oledsettransport(), e.g. the emulator in oled1106emu.c).                */
 /*                                                                            */
 /* (c) Tim Holyoake, 2nd May 2020.                                            */
 /*                                                                            */
 /******************************************************************************/
+#ifndef OLED1106_H
+#define OLED1106_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+#ifndef OLEDNOPIGPIO
 #include <pigpiod_if2.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* SH1106 I2C device address */
 
 #define SH1106ADDR      0x3C    // I2C address of OLED. Some use 0x3D instead.
 
+/* Pixel modes and framebuffer write codes */
+
+#define PIXOFF          0       // Set pixel off
+#define PIXON           1       // Set pixel on
+#define PIXINV          2       // Invert pixel (ON becomes OFF, OFF becomes ON)
+#define FBONLY          1       // Write to the framebufffer only
+#define FBANDDISPLAY    2       // Write to the framebuffer and display simultaneously.
+
+/* SH1106 library error codes */
+
+#define PAGETOOLOW      -1000   // Page specified as 0 or lower
+#define PAGETOOHIGH     -1001   // Page specified as 9 or higher
+#define BADPIXELCMD     -1002   // Command not PIXON, PIXOFF or PIXINV
+#define COLOUTOFRANGE   -1003   // Column is < ORIGIN or > ORIGIN+127
+#define ROWOUTOFRANGE   -1004   // Row is < ORIGIN or > ORIGIN+63
+#define NEGORZERORADIUS -1005   // Tried to draw a circle with negative or zero radius
+#define INVALIDFBCODE   -1006   // Framebuffer write code is invalid
+#define BADIMAGE        -1007   // Image size or conversion method is invalid
+#define BADORIENTATION  -1008   // Rotation or mirror flags are invalid
+#define BADPOLYGON      -1009   // Polygon has fewer than 3 or more than OLEDMAXPOLY vertices
+#define NOTRANSPORT     -1010   // Built with OLEDNOPIGPIO and no transport set
+#define BADASSET        -1011   // Not an asset pack, or no such asset in it
+#define LAYERFULL       -1012   // Sprite layer already holds OLEDMAXSPRITES sprites
+#define NOTONLAYER      -1013   // Sprite is not on the layer
+#define BADRATE         -1014   // Rate below 1Hz, or no update function
+#define OLEDLASTERROR   BADRATE         // Lowest error code in use
+
+#define OLEDMAXPOLY     64      // Most vertices oledfillpoly() accepts
+#define OLEDTEXTCACHE   32      // Text runs kept by oledstrcached()
+#define OLEDWALLMAX     16      // Most panels in a video wall
+#define OLEDMAXLAYERS   8       // Most layers in a stack
+
+/* Layer blends for oledlayerinit() */
+
+#define OLEDBLENDOR     0       // Set pixels are turned on
+#define OLEDBLENDXOR    1       // Set pixels invert what is below
+#define OLEDBLENDMASK   2       // Set pixels are turned off
+
+/* Display orientations for oledrotate(). Rotation is clockwise; the mirror   */
+/* flags may be combined with each other and with any rotation.               */
+
+#define OLEDROT0        0
+#define OLEDROT90       1       // Only x=33 to x=96 of the framebuffer is visible
+#define OLEDROT180      2
+#define OLEDROT270      3       // Only x=33 to x=96 of the framebuffer is visible
+#define OLEDMIRRORX     0x01    // Mirror left to right
+#define OLEDMIRRORY     0x02    // Mirror top to bottom
+
+/* Argument checking. Every function validates its arguments and reports      */
+/* failures through olederror(), in every build. -DOLEDNOCHECK only removes   */
+/* the checks inside the library's per-pixel helpers (see oled1106.c).        */
+
+#define OLEDCHECK(cond, errnum) do { if (cond) return(olederror(errnum)); } while (0)
+
+/* Grayscale to 1bpp conversion methods for oleddither() */
+
+#define OLEDTHRESHOLD   0       // On if at or above a fixed level
+#define OLEDBAYER       1       // Ordered dither with an 8x8 Bayer matrix
+#define OLEDFLOYD       2       // Floyd-Steinberg error diffusion
+#define OLEDATKINSON    3       // Atkinson error diffusion (lighter, more contrast)
+
 /* Declare SH1106 library functions as externals */
 
 extern void olederror_fprintf(int errnum);
+extern int olederror(int errnum);
+extern int oledlasterror(void);
+extern void oledseterrorhandler(void (*handler)(int errnum));
+extern int oledwrite(int pi, int fd, char *buf, unsigned len);
+extern void oledsettransport(int (*fn)(void *ctx, int pi, int fd, char *buf, unsigned len), void *ctx);
+extern void oledbatchbegin(void);
+extern int oledbatchend(void);
 extern int oledflushfb(int pi, int fd);
+extern int oledflushpages(int pi, int fd, uint8_t pagemask);
+extern int oledflushrect(int pi, int fd, int x, int y, int w, int h);
+extern int oledflushdiff(int pi, int fd, const char *fb, char *shadow);
+extern char *oledgetfb(void);
+extern void oledsetfb(char *fb);
+extern uint32_t oledutf8(const char **s);
+extern int oledglyphfind(const uint32_t (*runs)[3], int nruns, uint32_t c, int *hint);
+extern uint32_t oledglyphfallback(uint32_t c);
 extern int oledstr(int pi, int fd, char *writebuf, uint8_t page, uint8_t fontnum, uint8_t fbwrite);
+extern int oledstrscaled(int pi, int fd, const char *s, int scale, int x, int y, uint8_t mode, uint8_t fbwrite);
+extern int oledstrcached(int pi, int fd, char *writebuf, uint8_t page, uint8_t fontnum, uint8_t fbwrite);
+extern void oledtextcacheclear(void);
+extern double oledtextcachestats(long *hits, long *misses);
 extern int oledclear(int pi, int fd, uint8_t fbwrite);
 extern int oledinit(int pi, int fd);
+extern int oledrotate(int pi, int fd, uint8_t rotation, uint8_t mirror);
+extern uint8_t oledgetrotation(void);
 extern int oledoff(int pi, int fd);
 extern int oledon(int pi, int fd);
 extern int oledrv(int pi, int fd);
@@ -33,10 +127,309 @@ extern int olednv(int pi, int fd);
 extern int oledsetpage(int pi, int fd, int pageno);
 extern int oledresetcol(int pi, int fd); 
 extern int oledresetline(int pi, int fd);
+extern int oledstartline(int pi, int fd, int line);
 extern int oledhorizline(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t xlen, uint8_t mode, uint8_t fbwrite);
 extern int oledvertline(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t ylen, uint8_t mode, uint8_t fbwrite);
 extern int oledrectangle(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t xlen, uint8_t ylen, uint8_t mode, uint8_t fbwrite);
 extern int oledfillrect(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t xlen, uint8_t ylen, uint8_t mode, uint8_t fbwrite);
 extern int oledcircle(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t r, uint8_t mode, uint8_t fbwrite);
 extern int oledfillcircle(int pi, int fd, uint8_t startx, uint8_t starty, uint8_t r, uint8_t mode, uint8_t fbwrite);
+extern int oledfillpoly(int pi, int fd, const int *xy, int n, uint8_t mode, uint8_t fbwrite);
+extern int oledfilltri(int pi, int fd, int x0, int y0, int x1, int y1, int x2, int y2, uint8_t mode, uint8_t fbwrite);
 extern int oledsetpixel(int pi, int fd, uint8_t x, uint8_t y, uint8_t mode, uint8_t fbwrite);
+extern int oledbitmap(int pi, int fd, const uint8_t *bits, int w, int h, int x, int y, uint8_t mode, uint8_t fbwrite);
+extern int oleddither(const uint8_t *src, int width, int height, int stride, uint8_t method, uint8_t level, char *fb);
+
+/* Shared memory framebuffer (oled1106shm.c). One display server owns the     */
+/* device and flushes; any number of client processes map the segment, draw   */
+/* into it with the functions above (FBONLY) and post damaged pages.          */
+
+#define OLEDSHMNAME     "/oled1106fb"   // Default POSIX shared memory object name
+#define OLEDSHMMAGIC    0x31313036      // Marks an initialised segment
+
+struct oledshm {
+	uint32_t magic;         // OLEDSHMMAGIC once the server has set up the segment
+	uint32_t damage;        // Futex word - bumped by clients after each damage post
+	uint32_t pagemask;      // Pages damaged since the last flush (bit 0 = page 1)
+	uint32_t flushes;       // Number of flushes the server has completed
+	char fb[8][128];        // The shared framebuffer, same layout as oledgetfb()
+};
+
+extern struct oledshm *oledshmcreate(const char *name);
+extern struct oledshm *oledshmattach(const char *name);
+extern int oledshmdetach(struct oledshm *shm);
+extern int oledshmdamage(struct oledshm *shm, uint8_t pagemask);
+extern uint8_t oledshmwait(struct oledshm *shm, int timeoutms);
+
+/* Sprites (oled1106sprite.c). Bitmaps use the oledbitmap() layout; a sprite  */
+/* with nframes frames holds them one after another, as does its mask. The    */
+/* fields below the line are maintained by the library.                       */
+
+#define OLEDMAXSPRITES  32      // Sprites per layer
+#define OLEDMAXDIRTY    (2*OLEDMAXSPRITES)
+
+struct oledrect {
+	int x, y, w, h;         // Bottom left corner, width and height in pixels
+};
+
+struct oledsprite {
+	const uint8_t *bits;    // Frame bitmaps
+	const uint8_t *mask;    // Optional masks (set bits are cleared first), or NULL
+	int w, h, nframes;      // Size of one frame, number of frames
+	int x, y;               // Bottom left corner - may be partly off the display
+	int frame;              // Frame to show, 0 to nframes-1
+	int frameticks;         // Step to the next frame every frameticks ticks (0 = never)
+	int z;                  // Higher z is drawn on top
+	int visible;
+	/* ---- */
+	int drawn, drawnx, drawny, drawnframe, drawnz;
+};
+
+struct oledspritelayer {
+	struct oledsprite *sprite[OLEDMAXSPRITES];
+	int count;
+	long ticks;
+	struct oledrect dirty[OLEDMAXDIRTY];
+	int ndirty;
+	char bg[8][128];        // Background captured by oledspritebackground()
+};
+
+extern int oledspriteinit(struct oledspritelayer *layer);
+extern int oledspritebackground(struct oledspritelayer *layer);
+extern int oledspriteadd(struct oledspritelayer *layer, struct oledsprite *s);
+extern int oledspriteremove(struct oledspritelayer *layer, struct oledsprite *s);
+extern int oledspritetick(int pi, int fd, struct oledspritelayer *layer, uint8_t fbwrite);
+extern int oledspriterun(int pi, int fd, struct oledspritelayer *layer, int hz,
+                         int (*update)(struct oledspritelayer *layer, void *ctx), void *ctx);
+
+/* Virtual canvas (oled1106canvas.c). An offscreen image of any size in the   */
+/* framebuffer's page-major layout, panned across with a 128x64 viewport.     */
+
+struct oledcanvas {
+	int w, h, pages;        // Size in pixels, and in pages of 8 rows
+	char *bits;             // pages*w bytes, page 0 (bottom) first
+	/* ---- */
+	int vx, vy;             // Window shown by oledviewportscroll(), -1 if none
+	char gram[8][128];      // Copy of display RAM while scrolling
+};
+
+extern int oledcanvasinit(struct oledcanvas *c, int w, int h);
+extern void oledcanvasfree(struct oledcanvas *c);
+extern int oledcanvaspixel(struct oledcanvas *c, int x, int y, uint8_t mode);
+extern int oledcanvasput(struct oledcanvas *c, int x, int y);
+extern int oledviewport(int pi, int fd, struct oledcanvas *c, int x, int y, uint8_t fbwrite);
+extern int oledviewportscroll(int pi, int fd, struct oledcanvas *c, int x, int y);
+
+/* Four level grayscale (oled1106gray.c). Level = 2*high plane bit + low      */
+/* plane bit; a presenter thread shows the high plane twice as long as the    */
+/* low one. Draw into plane, then oledgraycommit(). The fields below the line */
+/* are maintained by the library.                                             */
+
+struct oledgray {
+	uint8_t plane[2][8][128];       // Drawing planes, [0] low bit, [1] high bit
+	/* ---- */
+	uint8_t next[2][8][128];        // Planes last committed
+	uint8_t front[2][8][128];       // Planes being presented
+	uint8_t shadow[8][128];         // What the display shows now
+	int fresh;                      // Shadow not known yet - send everything
+	int pending, running, error;
+	int pi, fd, hz;
+	long cycles, missed, bytes;     // Cycles shown, subframes late, data sent
+	int64_t worstlate;              // Worst overrun, ns
+	pthread_mutex_t lock;
+	pthread_t thread;
+};
+
+extern int oledgrayinit(struct oledgray *g);
+extern int oledgraypixel(struct oledgray *g, int x, int y, uint8_t level);
+extern int oledgrayimage(struct oledgray *g, const uint8_t *src, int width, int height, int stride);
+extern int oledgraycommit(struct oledgray *g);
+extern int oledgraystart(int pi, int fd, struct oledgray *g, int hz);
+extern int oledgraystop(struct oledgray *g);
+extern void oledgrayreport(struct oledgray *g, FILE *f);
+
+/* SH1106 emulator (oled1106emu.c). Passed to oledsettransport() with         */
+/* oledemuwrite(), it decodes the library's writes into an emulated display   */
+/* RAM and times them on an emulated I2C bus. hz and gapns may be changed.    */
+
+struct oledemu {
+	long hz;                        // I2C bus clock
+	long gapns;                     // Fixed cost of each write (driver, daemon), ns
+	/* ---- */
+	uint8_t gram[8][132];           // Display RAM, page 0 first
+	int page, col, rmwcol;          // Address pointers, rmwcol -1 unless read-modify-write
+	uint8_t startline, offset, mux, contrast;
+	uint8_t on, inverse, allon, segremap, comscan;
+	uint8_t cmd;                    // Command waiting for its argument, 0 if none
+	long writes, bytes, commands, data;
+	long overrun, unknown;          // Data past column 131, unrecognised commands
+	int64_t scl;                    // Bus clock cycles used
+};
+
+extern int oledemuinit(struct oledemu *e, long hz);
+extern int oledemuwrite(void *ctx, int pi, int fd, char *buf, unsigned len);
+extern int oledemupixel(const struct oledemu *e, int x, int y);
+extern void oledemuframe(const struct oledemu *e, char *fb);
+extern int oledemupbm(const struct oledemu *e, const char *path);
+extern double oledemuseconds(const struct oledemu *e);
+extern void oledemureport(const struct oledemu *e, FILE *f);
+
+/* 4-wire SPI transport (oled1106spi.c). oledspiopen() returns the handle to  */
+/* pass to oledinit() and the drawing functions instead of the I2C handle.    */
+
+struct oledspi {
+	int (*spiwrite)(int pi, unsigned h, char *buf, unsigned n);     // spi_write()
+	int (*dcwrite)(int pi, unsigned gpio, unsigned level);          // gpio_write()
+	int dc;                         // D/C GPIO
+	/* ---- */
+	int dcset, level;               // D/C has been written, and its level now
+	long transfers, bytes;
+};
+
+extern int oledspiopen(int pi, struct oledspi *s, unsigned chan, unsigned baud, int dcgpio, int resetgpio);
+extern int oledspiwrite(void *ctx, int pi, int fd, char *buf, unsigned len);
+extern int oledspiclose(int pi, int fd, struct oledspi *s);
+
+/* Video wall (oled1106wall.c). cols x rows panels as one display, its        */
+/* framebuffer one 1024 byte tile per panel, flushed by a thread per I2C bus. */
+
+struct oledwallpanel {
+	int pi, fd, bus;
+	char *tile;                     // This panel's part of the wall framebuffer
+	char shadow[8][128];            // What the panel shows now
+	int fresh;                      // Shadow not known yet - send everything
+	long bytes;                     // Display data sent to the panel
+};
+
+struct oledwallbus {
+	int id;                         // Bus number given to oledwalladd()
+	struct oledwall *wall;
+	pthread_t thread;
+	long gen;                       // Flush request the thread starts after
+	int error;                      // Result of the last flush ...
+	long sent;                      // ... and the bytes it sent
+};
+
+struct oledwall {
+	int cols, rows;                 // Panels across and up
+	char *fb;                       // cols*rows tiles, bottom row first
+	/* ---- */
+	int npanels, nbus, threads;
+	struct oledwallpanel panel[OLEDWALLMAX];
+	struct oledwallbus bus[OLEDWALLMAX];
+	int running, pending;
+	long gen;                       // Flush requests made
+	pthread_mutex_t lock;
+	pthread_cond_t go, done;
+};
+
+extern int oledwallinit(struct oledwall *w, int cols, int rows);
+extern int oledwalladd(struct oledwall *w, int tx, int ty, int pi, int fd, int bus);
+extern int oledwallselect(struct oledwall *w, int tx, int ty);
+extern int oledwallpixel(struct oledwall *w, int x, int y, uint8_t mode);
+extern int oledwallstart(struct oledwall *w);
+extern int oledwallflush(struct oledwall *w);
+extern void oledwallstop(struct oledwall *w);
+extern void oledwallfree(struct oledwall *w);
+
+/* Layers (oled1106layer.c). Each layer is a 1024 byte bitmap in the          */
+/* framebuffer's layout, held as 128 words so it can be blended 8 columns at  */
+/* a time; oledlayerflush() composites a stack of them into the framebuffer.  */
+
+struct oledlayer {
+	uint64_t bits[128];             // Page-major bitmap, page 0 (bottom) first
+	uint8_t blend;                  // OLEDBLENDOR, OLEDBLENDXOR or OLEDBLENDMASK
+	uint8_t isstatic;               // Drawn once, recomposited only when invalidated
+	uint8_t visible;
+	/* ---- */
+	uint8_t invalid;                // Pages to recomposite whatever has changed
+	uint64_t prev[128];             // Contents at the last flush (not for static layers)
+};
+
+struct oledlayers {
+	struct oledlayer *layer[OLEDMAXLAYERS];  // Bottom first
+	int count;
+	/* ---- */
+	int nbase;                      // Static layers in base, -1 to rebuild it
+	uint64_t base[128];             // Composite of the static layers at the bottom
+	long composites, pages;         // Flushes made, pages recomposited
+};
+
+extern void oledlayerinit(struct oledlayer *l, uint8_t blend, uint8_t isstatic);
+extern int oledlayersinit(struct oledlayers *ls);
+extern int oledlayeradd(struct oledlayers *ls, struct oledlayer *l);
+extern void oledlayerselect(struct oledlayer *l);
+extern void oledlayerinvalidate(struct oledlayer *l);
+extern int oledlayerflush(int pi, int fd, struct oledlayers *ls, uint8_t fbwrite);
+
+/* Asset packs (oled1106asset.c, made by oled1106pack). A header, an index    */
+/* sorted by name, then bitmaps in oledbitmap()'s page-major layout - a font  */
+/* is its glyph index (runs of code points, see oledglyphfind()) followed by  */
+/* count glyph bitmaps of w x h one after the other. Numbers are in the byte  */
+/* order of the machine that made the pack (little endian on a Pi).           */
+
+#define OLEDPACKMAGIC   "OLEDPAK2"
+#define OLEDASSETNAME   24      // Longest asset name, with its terminating NUL
+#define OLEDASSETIMAGE  0
+#define OLEDASSETFONT   1
+
+struct oledpackheader {
+	char magic[8];                  // OLEDPACKMAGIC, not terminated
+	uint32_t count;                 // Entries in the index
+	uint32_t size;                  // Of the whole pack, bytes
+};
+
+struct oledasset {
+	char name[OLEDASSETNAME];       // NUL padded
+	uint32_t offset;                // Of the glyph index or bitmaps from the start of the pack
+	uint16_t w, h;                  // Image size, or a font's character cell
+	uint16_t count;                 // Glyphs (1 for an image)
+	uint16_t runs;                  // Runs in a font's glyph index (0 for an image)
+	uint8_t type;                   // OLEDASSETIMAGE or OLEDASSETFONT
+	uint8_t pad[3];
+};
+
+struct oledpack {
+	const uint8_t *map;             // The whole pack, mapped read-only
+	size_t size;
+	const struct oledasset *index;
+	uint32_t count;
+};
+
+extern int oledpackopen(struct oledpack *p, const char *path);
+extern void oledpackclose(struct oledpack *p);
+extern const struct oledasset *oledpackfind(const struct oledpack *p, const char *name);
+extern const uint8_t *oledassetbits(const struct oledpack *p, const struct oledasset *a, int n);
+extern const uint32_t (*oledassetruns(const struct oledpack *p, const struct oledasset *a))[3];
+extern int oledpackdraw(int pi, int fd, const struct oledpack *p, const char *name,
+                        int x, int y, uint8_t mode, uint8_t fbwrite);
+extern int oledpackstr(int pi, int fd, const struct oledpack *p, const char *font, const char *s,
+                       int x, int y, uint8_t mode, uint8_t fbwrite);
+
+/* Strip charts (oled1106chart.c). The last w samples of a value, newest on   */
+/* the right, moved a column left for each new sample. lo, hi and style may   */
+/* be changed, followed by oledchartredraw().                                 */
+
+#define OLEDCHARTLINE   0       // Each sample joined to the one before
+#define OLEDCHARTBAR    1       // Filled down to the bottom row
+#define OLEDCHARTDOT    2       // One pixel per sample
+
+struct oledchart {
+	int x, y, w, h;                 // Rectangle, (x,y) its bottom left pixel
+	double lo, hi;                  // Values drawn on the bottom and top rows
+	uint8_t style;                  // OLEDCHARTLINE, OLEDCHARTBAR or OLEDCHARTDOT
+	/* ---- */
+	double ring[129];               // The last w+1 samples (one off the left edge)
+	int head, count;                // Next slot in ring, samples in it
+	long samples;                   // Added since oledchartinit()
+};
+
+extern int oledchartinit(struct oledchart *c, int x, int y, int w, int h, double lo, double hi, uint8_t style);
+extern int oledchartadd(int pi, int fd, struct oledchart *c, double v, uint8_t fbwrite);
+extern int oledchartredraw(int pi, int fd, struct oledchart *c, uint8_t fbwrite);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
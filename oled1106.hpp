@@ -0,0 +1,222 @@
+/******************************************************************************/
+/*                                                                            */
+/* Header only C++ (C++20) wrapper for the                                    */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* The C functions take the pixel mode and framebuffer write code as run time */
+/* arguments and test them for every pixel. Here they are template arguments, */
+/* so each drawing kernel is compiled for exactly one operation and flush     */
+/* policy, with clipping done by masking rather than branching. Fonts and     */
+/* masks are built at compile time. Anything not covered here (circles,       */
+/* sprites, dithering, ...) is still there through the C API, which this      */
+/* header leaves untouched and shares the same framebuffer with.              */
+/*                                                                            */
+/*      oled::Display d(pi,fd);                                               */
+/*      d.init();                                                             */
+/*      d.fillrect<oled::Pix::On>(1,1,20,10);                                 */
+/*      d.str<oled::FbAndDisplay>("Hello",8);                                 */
+/*                                                                            */
+/******************************************************************************/
+#ifndef OLED1106_HPP
+#define OLED1106_HPP
+
+#if __cplusplus < 202002L
+#error "oled1106.hpp needs C++20 (std::span) - build with -std=c++20"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include "oled1106.h"
+#include "oled1106font.h"
+
+namespace oled {
+
+/* Pixel operations and flush policies */
+
+enum class Pix : uint8_t { Off = PIXOFF, On = PIXON, Inv = PIXINV };
+
+struct FbOnly {};               // Draw into the framebuffer only
+struct FbAndDisplay {};         // Draw, then flush just the area drawn
+
+struct Point {
+	int x, y;               // (1,1) is bottom left, as in the C library
+};
+
+inline constexpr int columns = 128;
+inline constexpr int rows = 64;
+inline constexpr int pages = 8;
+
+namespace detail {
+
+/* Glyphs in display column order. The C font is stored mirrored (see         */
+/* oled1106font.h); oledstr() reverses each glyph as it draws it, here        */
+/* the compiler does it once.                                                 */
+
+template <std::size_t N>
+constexpr std::array<std::array<uint8_t, 8>, N> makeglyphs(const uint8_t (&font)[N][8]) {
+	std::array<std::array<uint8_t, 8>, N> g{};
+	for (std::size_t c = 0; c < N; c++)
+		for (int i = 0; i < 8; i++)
+			g[c][i] = font[c][7-i];
+	return g;
+}
+
+inline constexpr auto glyphs = makeglyphs(oledf8x8);
+inline constexpr auto xglyphs = makeglyphs(oledf8x8x);  // Beyond ASCII
+
+/* The glyph for code point ch, following oledglyphfallback() if the font     */
+/* hasn't got it, as oledstr() does. hint as for oledglyphfind().             */
+
+inline const uint8_t *glyph(uint32_t ch, int &hint) noexcept {
+	if (ch < 32) ch = 32;
+	for (;;) {
+		if (ch < 128) return glyphs[ch-32].data();
+		int n = oledglyphfind(oledf8x8xruns, std::size(oledf8x8xruns), ch, &hint);
+		if (n >= 0) return xglyphs[n].data();
+		ch = oledglyphfallback(ch);
+	}
+}
+
+/* rowmask[a][b] has bits a to b (inclusive) set - the rows of one page       */
+/* covered by a span starting at row a and ending at row b of the page.       */
+
+constexpr std::array<std::array<uint8_t, 8>, 8> makerowmasks() {
+	std::array<std::array<uint8_t, 8>, 8> m{};
+	for (int a = 0; a < 8; a++)
+		for (int b = a; b < 8; b++)
+			m[a][b] = static_cast<uint8_t>((0xFF << a) & (0xFF >> (7-b)));
+	return m;
+}
+
+inline constexpr auto rowmask = makerowmasks();
+
+template <Pix Op>
+constexpr void apply(uint8_t &b, uint8_t m) noexcept {
+	if constexpr (Op == Pix::On) b |= m;
+	else if constexpr (Op == Pix::Off) b &= static_cast<uint8_t>(~m);
+	else b ^= m;
+}
+
+} // namespace detail
+
+class Display {
+public:
+	Display(int pi, int fd) noexcept : pi_(pi), fd_(fd) {}
+
+	int pi() const noexcept { return pi_; }
+	int fd() const noexcept { return fd_; }
+
+	int init() noexcept { return oledinit(pi_, fd_); }
+	int flush() noexcept { return oledflushfb(pi_, fd_); }
+	int flushrect(int x, int y, int w, int h) noexcept { return oledflushrect(pi_, fd_, x, y, w, h); }
+
+	template <class Flush = FbOnly>
+	int clear() noexcept {
+		return oledclear(pi_, fd_, std::is_same_v<Flush, FbAndDisplay> ? FBANDDISPLAY : FBONLY);
+	}
+
+	/* The framebuffer as 8 pages of 128 columns, page 1 (bottom) first */
+
+	std::span<uint8_t, columns*pages> framebuffer() const noexcept {
+		return std::span<uint8_t, columns*pages>(reinterpret_cast<uint8_t *>(oledgetfb()), columns*pages);
+	}
+
+	template <Pix Op, class Flush = FbOnly>
+	int pixel(int x, int y) noexcept {
+		plot<Op>(framebuffer().data(), x, y);
+		return finish<Flush>(x, y, 1, 1);
+	}
+
+	/* Bulk pixels. Off-display points are masked out, not branched round. */
+
+	template <Pix Op, class Flush = FbOnly>
+	int pixels(std::span<const Point> pts) noexcept {
+		uint8_t *fb = framebuffer().data();
+		for (const Point &p : pts) plot<Op>(fb, p.x, p.y);
+		if constexpr (std::is_same_v<Flush, FbAndDisplay>) return flush();
+		return 0;
+	}
+
+	template <Pix Op, class Flush = FbOnly>
+	int hline(int x, int y, int len) noexcept { return fillrect<Op, Flush>(x, y, len, 1); }
+
+	template <Pix Op, class Flush = FbOnly>
+	int vline(int x, int y, int len) noexcept { return fillrect<Op, Flush>(x, y, 1, len); }
+
+	/* Filled rectangle w x h with bottom left (x,y), clipped. Each page */
+	/* is one masked operation per column rather than one per pixel.     */
+
+	template <Pix Op, class Flush = FbOnly>
+	int fillrect(int x, int y, int w, int h) noexcept {
+		int x0 = std::max(x, 1)-1, x1 = std::min(x+w-1, columns)-1;
+		int r0 = std::max(y, 1)-1, r1 = std::min(y+h-1, rows)-1;
+		if ((x0 > x1) || (r0 > r1)) return 0;
+
+		uint8_t *fb = framebuffer().data();
+		for (int pg = r0/8; pg <= r1/8; pg++) {
+			uint8_t m = detail::rowmask[pg == r0/8 ? r0%8 : 0][pg == r1/8 ? r1%8 : 7];
+			uint8_t *row = fb+pg*columns;
+			for (int c = x0; c <= x1; c++) detail::apply<Op>(row[c], m);
+		}
+		return finish<Flush>(x, y, w, h);
+	}
+
+	/* Text on page 1-8 starting at column col, clipped at the right edge. */
+	/* UTF-8, drawn with the same glyphs and fallbacks as oledstr().       */
+
+	template <class Flush = FbOnly>
+	int str(std::string_view s, int page, int col = 1) noexcept {
+		if (page < 1) return olederror(PAGETOOLOW);
+		if (page > pages) return olederror(PAGETOOHIGH);
+		if ((col < 1) || (col > columns)) return olederror(COLOUTOFRANGE);
+
+		// No more than 16 characters fit - decode from a terminated copy of them
+		char text[4*columns/8+1] = {};
+		std::copy_n(s.data(), std::min(s.size(), sizeof(text)-1), text);
+
+		uint8_t *row = framebuffer().data()+(page-1)*columns;
+		int c = col-1, hint = 0;
+		for (const char *p = text; *p && (c < columns); ) {
+			const uint8_t *g = detail::glyph(oledutf8(&p), hint);
+			for (int i = 0; (i < 8) && (c < columns); i++, c++) row[c] = g[i];
+		}
+		return finish<Flush>(col, (page-1)*8+1, c-(col-1), 8);
+	}
+
+	/* Page-major bitmap (see oledbitmap()) at any pixel position */
+
+	template <Pix Op, class Flush = FbOnly>
+	int bitmap(std::span<const uint8_t> bits, int w, int h, int x, int y) noexcept {
+		if (bits.size() < static_cast<size_t>(w)*((h+7)/8)) return olederror(BADIMAGE);
+		return oledbitmap(pi_, fd_, bits.data(), w, h, x, y, static_cast<uint8_t>(Op),
+		                  std::is_same_v<Flush, FbAndDisplay> ? FBANDDISPLAY : FBONLY);
+	}
+
+private:
+	int pi_, fd_;
+
+	/* Branch-free clipped pixel: an off-display point gets a zero mask */
+	/* and a harmless in-range index.                                   */
+
+	template <Pix Op>
+	static void plot(uint8_t *fb, int x, int y) noexcept {
+		unsigned cx = static_cast<unsigned>(x-1), cy = static_cast<unsigned>(y-1);
+		uint8_t on = static_cast<uint8_t>(-static_cast<int>((cx < columns) & (cy < rows)));
+		detail::apply<Op>(fb[((cy >> 3) & (pages-1))*columns+(cx & (columns-1))],
+		                  static_cast<uint8_t>(on & (1u << (cy & 7))));
+	}
+
+	template <class Flush>
+	int finish(int x, int y, int w, int h) noexcept {
+		if constexpr (std::is_same_v<Flush, FbAndDisplay>) return flushrect(x, y, w, h);
+		return 0;
+	}
+};
+
+} // namespace oled
+
+#endif
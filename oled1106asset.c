@@ -0,0 +1,186 @@
+/******************************************************************************/
+/*                                                                            */
+/* Asset pack support for the                                                 */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A pack is made at build time by oled1106pack from PBM, XBM and BDF files.  */
+/* It holds a header, an index sorted by name and the bitmaps already in      */
+/* oledbitmap()'s page-major layout, so opening one is a single mmap() and a  */
+/* check of the header - the same however many assets it holds - and an       */
+/* asset is found by binary search and drawn straight from the mapping.       */
+/* Fonts may cover any Unicode code points; each carries a glyph index of     */
+/* runs of consecutive code points, so a sparse font needs no table with an   */
+/* entry per code point, and text is UTF-8.                                   */
+/*                                                                            */
+/*      struct oledpack pk;                                                   */
+/*      oledpackopen(&pk,"assets.pak");                                       */
+/*      oledpackdraw(pi,fd,&pk,"wifi",110,50,PIXON,FBONLY);                   */
+/*      oledpackstr(pi,fd,&pk,"6x10","21.5C",1,1,PIXON,FBANDDISPLAY);         */
+/*                                                                            */
+/******************************************************************************/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "oled1106.h"
+
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define RUNSIZE         12      // Bytes per glyph index run: first, count, glyph
+
+int oledpackopen(struct oledpack *p, const char *path) {
+/******************************************************************************/
+/*                                                                            */
+/* Map the pack at path read-only. Returns 0, BADASSET if the file is not a   */
+/* pack (or was cut short), or -1 (errno set) if it can't be opened or        */
+/* mapped.                                                                    */
+/*                                                                            */
+/******************************************************************************/
+	const struct oledpackheader *hd;
+	struct stat st;
+	void *m;
+	int fd;
+
+	memset(p, 0, sizeof(*p));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return(-1);
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return(-1);
+	}
+	if ((size_t)st.st_size < sizeof(struct oledpackheader)) {
+		close(fd);
+		return(olederror(BADASSET));
+	}
+
+	m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);                              // The mapping keeps the file
+	if (m == MAP_FAILED) return(-1);
+
+	hd = m;
+	if ((memcmp(hd->magic, OLEDPACKMAGIC, sizeof(hd->magic)) != 0) ||
+	    (hd->size != (uint64_t)st.st_size) ||
+	    (sizeof(*hd)+(uint64_t)hd->count*sizeof(struct oledasset) > (uint64_t)st.st_size)) {
+		munmap(m, st.st_size);
+		return(olederror(BADASSET));
+	}
+
+	p->map = m;
+	p->size = st.st_size;
+	p->index = (const struct oledasset *)(p->map+sizeof(*hd));
+	p->count = hd->count;
+
+	return(0);
+}
+
+void oledpackclose(struct oledpack *p) {
+/******************************************************************************/
+/*                                                                            */
+/* Unmap a pack. Pointers into it are no longer valid.                        */
+/*                                                                            */
+/******************************************************************************/
+
+	if (p->map != NULL) munmap((void *)p->map, p->size);
+	memset(p, 0, sizeof(*p));
+	return;
+}
+
+const struct oledasset *oledpackfind(const struct oledpack *p, const char *name) {
+/******************************************************************************/
+/*                                                                            */
+/* Find an asset by name (binary search of the index). Returns NULL if there  */
+/* is none, or if its glyph index or bitmaps would run past the end of the    */
+/* pack.                                                                      */
+/*                                                                            */
+/******************************************************************************/
+	const struct oledasset *a;
+	uint32_t lo = 0, hi = p->count, mid;
+	uint64_t len;
+	int i;
+
+	while (lo < hi) {
+		mid = lo+(hi-lo)/2;
+		a = &p->index[mid];
+		i = strncmp(name, a->name, OLEDASSETNAME);
+		if (i == 0) {
+			len = (uint64_t)a->w*((a->h+ROWSPERPAGE-1)/ROWSPERPAGE)*a->count+a->runs*RUNSIZE;
+			if ((uint64_t)a->offset+len > p->size) return(NULL);
+			return(a);
+		}
+		if (i < 0) hi = mid;
+		else lo = mid+1;
+	}
+
+	return(NULL);
+}
+
+const uint8_t *oledassetbits(const struct oledpack *p, const struct oledasset *a, int n) {
+/******************************************************************************/
+/*                                                                            */
+/* The page-major bitmap of image a (n = 0), or of glyph n of font a, inside  */
+/* the mapping, ready for oledbitmap(). NULL if n is out of range.            */
+/*                                                                            */
+/******************************************************************************/
+
+	if ((n < 0) || (n >= a->count)) return(NULL);
+	return(p->map+a->offset+a->runs*RUNSIZE+(size_t)n*a->w*((a->h+ROWSPERPAGE-1)/ROWSPERPAGE));
+}
+
+const uint32_t (*oledassetruns(const struct oledpack *p, const struct oledasset *a))[3] {
+/******************************************************************************/
+/*                                                                            */
+/* Font a's glyph index inside the mapping, a->runs runs of {first code       */
+/* point, count, first glyph}, ready for oledglyphfind().                     */
+/*                                                                            */
+/******************************************************************************/
+
+	return((const uint32_t (*)[3])(p->map+a->offset));
+}
+
+int oledpackdraw(int pi, int fd, const struct oledpack *p, const char *name,
+                 int x, int y, uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Draw image name from the pack with its bottom left corner at (x,y), as     */
+/* oledbitmap() does. Returns BADASSET if the pack has no such image.         */
+/*                                                                            */
+/******************************************************************************/
+	const struct oledasset *a = oledpackfind(p, name);
+
+	OLEDCHECK((a == NULL) || (a->type != OLEDASSETIMAGE), BADASSET);
+
+	return(oledbitmap(pi, fd, oledassetbits(p, a, 0), a->w, a->h, x, y, mode, fbwrite));
+}
+
+int oledpackstr(int pi, int fd, const struct oledpack *p, const char *font, const char *s,
+                int x, int y, uint8_t mode, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Write s, which is UTF-8, in font from the pack with the bottom left of the */
+/* first character cell at (x,y), which may be any pixel. A character the     */
+/* font hasn't got is drawn as the first one oledglyphfallback() leads to     */
+/* that it has - unaccented letter, U+FFFD, '?' - or left as a blank cell.    */
+/* Text running off the display is clipped. Returns BADASSET if the pack has  */
+/* no such font.                                                              */
+/*                                                                            */
+/******************************************************************************/
+	const struct oledasset *a = oledpackfind(p, font);
+	const uint32_t (*runs)[3];
+	uint32_t c;
+	int i, n, x0 = x, hint = 0;
+
+	OLEDCHECK((a == NULL) || (a->type != OLEDASSETFONT), BADASSET);
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	runs = oledassetruns(p, a);
+	for (; *s; x+=a->w) {
+		c = oledutf8(&s);
+		if (c < 32) c = ' ';
+		while (((n = oledglyphfind(runs, a->runs, c, &hint)) < 0) && (c != ' ')) c = oledglyphfallback(c);
+		if (n < 0) continue;
+		i = oledbitmap(pi, fd, oledassetbits(p, a, n), a->w, a->h, x, y, mode, FBONLY);
+		if (i != 0) return(i);
+	}
+
+	if (fbwrite == FBANDDISPLAY) return(oledflushrect(pi, fd, x0, y, x-x0, a->h));
+	return(0);
+}
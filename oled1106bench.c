@@ -0,0 +1,254 @@
+/******************************************************************************/
+/*                                                                            */
+/* Benchmark program for the                                                  */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Times the drawing primitives in framebuffer only mode, so no display or    */
+/* pigpiod daemon is needed. 'make bench' builds two copies: oled1106bench    */
+/* and oled1106benchnc with the library built with -DOLEDNOCHECK, which takes */
+/* the checks out of its per-pixel helpers, so running both shows what those  */
+/* checks cost. Public functions check their arguments in both.               */
+/* Display updates are run through the SH1106 emulator (oled1106emu.c) to     */
+/* estimate the frame rates a real I2C bus would allow. 'make benchemu'       */
+/* builds a copy that needs no pigpiod library at all (-DOLEDNOPIGPIO).       */
+/*                                                                            */
+/******************************************************************************/
+#include <time.h>
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+
+#define EMUFRAMES       100     // Frames sent to the emulator per estimate
+#define BENCHRUNS       512     // Runs in the made up sparse font's glyph index
+
+static volatile int sink;       // Stops the compiler discarding results
+static uint32_t runs[BENCHRUNS][3];
+static const char mixed[] = "Temp 21°C ±0.5 → Ωμ Привет 中文 😀 ÉTÉ";
+static const long emuhz[] = {100000, 400000, 1000000};
+static const char *dithers[] = {"threshold", "Bayer", "Floyd-Steinberg", "Atkinson"};
+static uint8_t gray[240][320];  // A video sized grayscale frame
+
+static double nsnow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec*1e9+ts.tv_nsec);
+}
+
+static void report(const char *what, double start, long calls) {
+	double ns=nsnow()-start;
+
+	printf("%-36s %10ld calls %9.1f ns/call\n",what,calls,ns/calls);
+	return;
+}
+
+static void fps(const char *what, struct oledemu *e, int64_t scl, long writes, long bytes) {
+	// Frame rates the traffic since scl/writes/bytes were noted would allow
+	struct oledemu d=*e;
+	unsigned i;
+
+	d.scl=e->scl-scl;
+	d.writes=e->writes-writes;
+	printf("%-36s %6ld bytes/frame",what,(e->bytes-bytes)/EMUFRAMES);
+	for (i=0; i<sizeof(emuhz)/sizeof(emuhz[0]); i++) {
+		d.hz=emuhz[i];
+		printf("  %5.1f fps @%ldk",EMUFRAMES/oledemuseconds(&d),emuhz[i]/1000);
+	}
+	printf("\n");
+	return;
+}
+
+int main(int argc, char *argv[]) {
+	int reps=200, r, x, y, hint, differs=0;
+	const char *s;
+	uint32_t c;
+	double t;
+	char what[40];
+	struct oledemu emu;
+	struct oledlayers stack;
+	struct oledlayer frame, value;
+	struct oledchart chart;
+	char shown[COLUMNS*ROWS/8];
+	int64_t scl;
+	long writes, bytes;
+
+	if (argc > 1) reps=atoi(argv[1]);
+	if (reps < 1) reps=1;
+
+#ifdef OLEDNOCHECK
+	printf("Per-pixel checks compiled out (OLEDNOCHECK)\n");
+#else
+	printf("Per-pixel checks enabled\n");
+#endif
+
+	t=nsnow();
+	for (r=0; r<reps; r++)
+		for (y=1; y<=ROWS; y++)
+			for (x=1; x<=COLUMNS; x++)
+				sink+=oledsetpixel(0,0,x,y,r & 1 ? PIXOFF : PIXON,FBONLY);
+	report("oledsetpixel, whole screen",t,(long)reps*COLUMNS*ROWS);
+
+	t=nsnow();
+	for (r=0; r<reps*16; r++)
+		for (y=1; y<=ROWS; y++)
+			sink+=oledhorizline(0,0,1,y,COLUMNS-1,PIXINV,FBONLY);
+	report("oledhorizline, 128 pixels",t,(long)reps*16*ROWS);
+
+	t=nsnow();
+	for (r=0; r<reps*8; r++)
+		sink+=oledfillrect(0,0,1,1,COLUMNS-1,ROWS-1,PIXINV,FBONLY);
+	report("oledfillrect, whole screen",t,(long)reps*8);
+
+	t=nsnow();
+	for (r=0; r<reps*8; r++)
+		sink+=oledcircle(0,0,10,10,40,PIXINV,FBONLY);  // Mostly clipped
+	report("oledcircle, r=40 clipped",t,(long)reps*8);
+
+	t=nsnow();
+	for (r=0; r<reps*8; r++)
+		sink+=oledfillcircle(0,0,64,32,30,PIXINV,FBONLY);
+	report("oledfillcircle, r=30",t,(long)reps*8);
+
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		for (y=1; y<=8; y++)
+			sink+=oledstr(0,0,y & 1 ? "CPU  42%" : "TEMP 51C",y,0,FBONLY);
+	report("oledstr, 8 chars",t,(long)reps*64*8);
+
+	oledtextcacheclear();
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		for (y=1; y<=8; y++)
+			sink+=oledstrcached(0,0,y & 1 ? "CPU  42%" : "TEMP 51C",y,0,FBONLY);
+	report("oledstrcached, 8 chars",t,(long)reps*64*8);
+	printf("%-36s %10.1f%%\n","  text cache hit rate",100*oledtextcachestats(NULL,NULL));
+
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		for (y=1; y<=8; y++)
+			sink+=oledstr(0,0,y & 1 ? "21°C→€5" : "Ωé ±½…↑",y,0,FBONLY);
+	report("oledstr, 8 chars UTF-8 mixed",t,(long)reps*64*8);
+
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		sink+=oledstrscaled(0,0,r & 1 ? "21°C" : "19°C",4,1,(r%32)+1,PIXON,FBONLY);
+	report("oledstrscaled, 4 chars 4x",t,(long)reps*64);
+
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		sink+=oledstrscaled(0,0,r & 1 ? "CPU  42%" : "TEMP 51C",2,1,(r%48)+1,PIXON,FBONLY);
+	report("oledstrscaled, 8 chars 2x",t,(long)reps*64);
+
+	// A made up sparse font: runs of 1 to 64 code points spread from U+0020 to
+	// beyond U+1F000, looked up for a string mixing scripts
+	for (r=0, c=0x20, x=0; r<BENCHRUNS; r++) {
+		runs[r][0]=c;
+		runs[r][1]=1+(r*29)%64;
+		runs[r][2]=x;
+		x+=runs[r][1];
+		c+=runs[r][1]+(r < 64 ? 32 : (r*211)%512);
+	}
+	for (s=mixed, x=0, y=0; (c=oledutf8(&s)) != 0; x++) y+=(c < 0x80);
+	t=nsnow();
+	for (r=0; r<reps*64; r++)
+		for (s=mixed, hint=0; (c=oledutf8(&s)) != 0; )
+			sink+=oledglyphfind(runs,BENCHRUNS,c,&hint);
+	report("UTF-8 decode + glyph lookup",t,(long)reps*64*x);
+	printf("%-36s %10d\n","  characters, of which not ASCII",x-y);
+
+	// A static frame with one changing value: redrawn whole, then as layers
+	t=nsnow();
+	for (r=0; r<reps*16; r++) {
+		sink+=oledclear(0,0,FBONLY);
+		sink+=oledrectangle(0,0,1,1,COLUMNS-1,ROWS-1,PIXON,FBONLY);
+		for (y=2; y<=7; y++) sink+=oledstr(0,0,"LABEL:",y,0,FBONLY);
+		sink+=oledstr(0,0,r & 1 ? "42" : "51",4,0,FBONLY);
+	}
+	report("frame redrawn whole",t,(long)reps*16);
+
+	oledlayersinit(&stack);
+	oledlayerinit(&frame,OLEDBLENDOR,1);
+	oledlayerinit(&value,OLEDBLENDXOR,0);
+	oledlayeradd(&stack,&frame);
+	oledlayeradd(&stack,&value);
+	oledlayerselect(&frame);
+	sink+=oledrectangle(0,0,1,1,COLUMNS-1,ROWS-1,PIXON,FBONLY);
+	for (y=2; y<=7; y++) sink+=oledstr(0,0,"LABEL:",y,0,FBONLY);
+	t=nsnow();
+	for (r=0; r<reps*16; r++) {
+		oledlayerselect(&value);
+		sink+=oledstr(0,0,r & 1 ? "42" : "51",4,0,FBONLY);
+		sink+=oledlayerflush(0,0,&stack,FBONLY);
+	}
+	report("frame as static + dynamic layers",t,(long)reps*16);
+	printf("%-36s %10.2f\n","  pages recomposited per flush",(double)stack.pages/stack.composites);
+	oledsetfb(NULL);
+
+	// A 128 sample strip chart: redrawn whole for each sample, then scrolled
+	oledchartinit(&chart,1,9,COLUMNS,50,0,100,OLEDCHARTLINE);
+	for (r=0; r<COLUMNS; r++) sink+=oledchartadd(0,0,&chart,50+45*((r*37)%19-9)/9.0,FBONLY);
+	t=nsnow();
+	for (r=0; r<reps*16; r++) {
+		chart.ring[chart.head]=r%100;
+		chart.head=(chart.head+1)%(chart.w+1);
+		sink+=oledchartredraw(0,0,&chart,FBONLY);
+	}
+	report("strip chart redrawn whole",t,(long)reps*16);
+
+	t=nsnow();
+	for (r=0; r<reps*16; r++) sink+=oledchartadd(0,0,&chart,r%100,FBONLY);
+	report("strip chart, oledchartadd",t,(long)reps*16);
+
+	// Grayscale conversion, a full screen frame with each method and a video
+	// sized frame scaled down to fit
+	for (y=0; y<240; y++)
+		for (x=0; x<320; x++) gray[y][x]=(x*255/319+y*(y+x)/97)&0xFF;
+	for (c=OLEDTHRESHOLD; c<=OLEDATKINSON; c++) {
+		t=nsnow();
+		for (r=0; r<reps*4; r++) sink+=oleddither(&gray[0][0],COLUMNS,ROWS,320,c,128,oledgetfb());
+		snprintf(what,sizeof(what),"oleddither, 128x64 %s",dithers[c]);
+		report(what,t,(long)reps*4);
+	}
+	t=nsnow();
+	for (r=0; r<reps; r++) sink+=oleddither(&gray[0][0],320,240,320,OLEDFLOYD,128,oledgetfb());
+	report("oleddither, 320x240 Floyd-Steinberg",t,(long)reps);
+
+	// Display updates through the emulator - bus time, not CPU time
+	oledemuinit(&emu,400000);
+	oledsettransport(oledemuwrite,&emu);
+	sink+=oledinit(0,0);
+	oledemuframe(&emu,shown);
+	r=memcmp(shown,oledgetfb(),sizeof(shown));
+	printf("%-36s %s\n","emulated display after oledinit",r ? "differs from framebuffer" : "matches framebuffer");
+	differs|=(r != 0);
+
+	scl=emu.scl; writes=emu.writes; bytes=emu.bytes;
+	for (r=0; r<EMUFRAMES; r++) sink+=oledflushfb(0,0);
+	fps("oledflushfb",&emu,scl,writes,bytes);
+
+	scl=emu.scl; writes=emu.writes; bytes=emu.bytes;
+	for (r=0; r<EMUFRAMES; r++) sink+=oledstr(0,0,r & 1 ? "CPU  42%" : "TEMP 51C",4,0,FBANDDISPLAY);
+	fps("oledstr, 8 chars, FBANDDISPLAY",&emu,scl,writes,bytes);
+
+	scl=emu.scl; writes=emu.writes; bytes=emu.bytes;
+	for (r=0; r<EMUFRAMES; r++) sink+=oledchartadd(0,0,&chart,r%100,FBANDDISPLAY);
+	fps("oledchartadd, 128x50, FBANDDISPLAY",&emu,scl,writes,bytes);
+
+	oledemuframe(&emu,shown);
+	r=memcmp(shown,oledgetfb(),sizeof(shown));
+	printf("%-36s %s\n","emulated display after updates",r ? "differs from framebuffer" : "matches framebuffer");
+	differs|=(r != 0);
+	oledsettransport(NULL,NULL);
+
+	// The error path - recorded per thread, nothing printed (no handler)
+	t=nsnow();
+	for (r=0; r<reps; r++)
+		for (x=0; x<COLUMNS*ROWS; x++)
+			sink+=oledsetpixel(0,0,0,0,PIXON,FBONLY);
+	report("oledsetpixel, invalid (no handler)",t,(long)reps*COLUMNS*ROWS);
+	sink+=oledlasterror();
+
+	// A display that doesn't match makes the frame rates meaningless
+	return(differs ? 1 : 0);
+}
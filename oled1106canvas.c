@@ -0,0 +1,226 @@
+/******************************************************************************/
+/*                                                                            */
+/* Virtual canvas support for the                                             */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A canvas is an offscreen image of any size (at least 128x64) in the same   */
+/* page-major layout as the framebuffer. It is drawn once and the display is  */
+/* then panned across it a pixel at a time. oledviewport() copies a window of */
+/* the canvas into the framebuffer, shifting each byte across the page pair   */
+/* it straddles, so the result can be drawn over before it is flushed.        */
+/* oledviewportscroll() instead keeps canvas row r in display RAM row r%64    */
+/* and pans vertically with the start line register, so moving the window up  */
+/* or down n rows only sends the pages those n new rows fall on.              */
+/*                                                                            */
+/******************************************************************************/
+#include <errno.h>
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define PAGES           8       // The top line of the diplay is on page 8.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+
+int oledcanvasinit(struct oledcanvas *c, int w, int h) {
+/******************************************************************************/
+/*                                                                            */
+/* Allocate a blank w x h pixel canvas. Returns 0, BADIMAGE if it would be    */
+/* smaller than the display, or -1 (errno set) if there is not enough memory. */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK((c == NULL) || (w < COLUMNS) || (h < ROWS), BADIMAGE);
+
+	c->w = w;
+	c->h = h;
+	c->pages = (h+ROWSPERPAGE-1)/ROWSPERPAGE;
+	c->bits = calloc((size_t)c->pages*w, 1);
+	c->vx = -1;
+	c->vy = -1;
+	if (c->bits == NULL) return(-1);
+
+	return(0);
+}
+
+void oledcanvasfree(struct oledcanvas *c) {
+/******************************************************************************/
+/*                                                                            */
+/* Release the memory held by a canvas.                                       */
+/*                                                                            */
+/******************************************************************************/
+
+	free(c->bits);
+	c->bits = NULL;
+	return;
+}
+
+int oledcanvaspixel(struct oledcanvas *c, int x, int y, uint8_t mode) {
+/******************************************************************************/
+/*                                                                            */
+/* Set (PIXON), clear (PIXOFF) or invert (PIXINV) pixel (x,y) of the canvas,  */
+/* (1,1) being its bottom left corner.                                        */
+/*                                                                            */
+/******************************************************************************/
+	char *b;
+	uint8_t bit;
+
+	OLEDCHECK(mode > PIXINV, BADPIXELCMD);
+	OLEDCHECK((x < ORIGIN) || (x >= c->w+ORIGIN), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y >= c->h+ORIGIN), ROWOUTOFRANGE);
+
+	b = c->bits+(size_t)((y-ORIGIN)/ROWSPERPAGE)*c->w+(x-ORIGIN);
+	bit = 0x01 << ((y-ORIGIN)%ROWSPERPAGE);
+	if (mode == PIXON) *b |= bit;
+	else if (mode == PIXOFF) *b &= ~bit;
+	else *b ^= bit;
+
+	return(0);
+}
+
+int oledcanvasput(struct oledcanvas *c, int x, int y) {
+/******************************************************************************/
+/*                                                                            */
+/* Copy the whole framebuffer into the canvas with its bottom left corner at  */
+/* (x,y), so anything the library can draw can be drawn on a canvas a screen  */
+/* at a time. The 128x64 area must lie within the canvas.                     */
+/*                                                                            */
+/******************************************************************************/
+	int p, col, shift;
+	uint8_t b, lomask, himask;
+	char *lo, *hi;
+	const char *fb = oledgetfb();
+
+	OLEDCHECK((x < ORIGIN) || (x+COLUMNS-ORIGIN > c->w), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y+ROWS-ORIGIN > c->h), ROWOUTOFRANGE);
+
+	shift = (y-ORIGIN)%ROWSPERPAGE;
+	lomask = 0xFF << shift;                 // Rows of the lower canvas page written
+	himask = ~lomask;                       // Rows of the upper canvas page written
+
+	for (p=0; p<PAGES; p++) {
+		lo = c->bits+(size_t)((y-ORIGIN)/ROWSPERPAGE+p)*c->w+(x-ORIGIN);
+		hi = lo+c->w;
+		for (col=0; col<COLUMNS; col++) {
+			b = fb[p*COLUMNS+col];
+			lo[col] = (lo[col] & ~lomask) | (uint8_t)(b << shift);
+			if (shift) hi[col] = (hi[col] & ~himask) | (b >> (ROWSPERPAGE-shift));
+		}
+	}
+
+	return(0);
+}
+
+int oledviewport(int pi, int fd, struct oledcanvas *c, int x, int y, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Copy the 128x64 window of the canvas with bottom left corner (x,y) into    */
+/* the framebuffer, flushing it too if fbwrite is FBANDDISPLAY. The window    */
+/* must lie within the canvas. When y-1 is not a multiple of 8 each           */
+/* framebuffer byte is made from the two canvas pages it straddles. If the    */
+/* canvas was being scrolled with oledviewportscroll(), the start line is put */
+/* back to 0 so the framebuffer appears the right way up again.               */
+/*                                                                            */
+/******************************************************************************/
+	int i, p, col, shift;
+	const uint8_t *lo, *hi;
+	char *fb = oledgetfb();
+
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+	OLEDCHECK((x < ORIGIN) || (x+COLUMNS-ORIGIN > c->w), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y+ROWS-ORIGIN > c->h), ROWOUTOFRANGE);
+
+	shift = (y-ORIGIN)%ROWSPERPAGE;
+	for (p=0; p<PAGES; p++) {
+		lo = (const uint8_t *)c->bits+(size_t)((y-ORIGIN)/ROWSPERPAGE+p)*c->w+(x-ORIGIN);
+		hi = lo+c->w;
+		if (shift == 0) {
+			memcpy(fb+p*COLUMNS, lo, COLUMNS);
+			continue;
+		}
+		for (col=0; col<COLUMNS; col++)
+			fb[p*COLUMNS+col] = (lo[col] >> shift) | (hi[col] << (ROWSPERPAGE-shift));
+	}
+
+	if (fbwrite == FBONLY) return(0);
+
+	if (c->vy >= 0) {                       // Leaving scroll mode
+		i = oledstartline(pi, fd, 0);
+		if (i != 0) return(i);
+		c->vx = -1;
+		c->vy = -1;
+	}
+
+	return(oledflushfb(pi, fd));
+}
+
+int oledviewportscroll(int pi, int fd, struct oledcanvas *c, int x, int y) {
+/******************************************************************************/
+/*                                                                            */
+/* Show the 128x64 window of the canvas with bottom left corner (x,y) using   */
+/* the start line register. Canvas row r (0 based) always lives in display    */
+/* RAM row r%64 and the start line is set to (y-1)%64, so after a vertical    */
+/* move only the pages holding newly exposed rows are sent. Display RAM page  */
+/* bytes line up bit for bit with canvas page bytes, so no shifting is needed */
+/* - at most two canvas pages 64 rows apart are merged with a mask. A change  */
+/* of x, or the first call, sends every page. The library's framebuffer is    */
+/* left alone (a copy of display RAM is kept in the canvas). The start line   */
+/* only scrolls the unturned display, so BADORIENTATION is returned when it   */
+/* is turned through 90 or 270 degrees. Call oledviewport() to go back to     */
+/* normal, unscrolled output.                                                 */
+/*                                                                            */
+/******************************************************************************/
+	int i, p, r, col, x0, y0, q, cyc;
+	uint8_t pagemask = 0, himask;
+	const uint8_t *lo, *hi;
+	char *prevfb;
+
+	OLEDCHECK((oledgetrotation() == OLEDROT90) || (oledgetrotation() == OLEDROT270), BADORIENTATION);
+	OLEDCHECK((x < ORIGIN) || (x+COLUMNS-ORIGIN > c->w), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y+ROWS-ORIGIN > c->h), ROWOUTOFRANGE);
+
+	x0 = x-ORIGIN;
+	y0 = y-ORIGIN;
+
+	/* Work out which display RAM pages now hold different canvas rows */
+
+	if ((c->vy < 0) || (c->vx != x0) || (abs(y0-c->vy) >= ROWS)) {
+		pagemask = 0xFF;
+	}
+	else if (y0 > c->vy) {
+		for (r=c->vy+ROWS; r<y0+ROWS; r++) pagemask |= 0x01 << ((r%ROWS)/ROWSPERPAGE);
+	}
+	else {
+		for (r=y0; r<c->vy; r++) pagemask |= 0x01 << ((r%ROWS)/ROWSPERPAGE);
+	}
+
+	/* Rebuild those pages. RAM row 8p+b holds the one canvas row in the  */
+	/* window equal to it mod 64: from cycle y0/64 if 8p+b >= y0%64, else */
+	/* from the next cycle up.                                             */
+
+	q = y0%ROWS;
+	cyc = y0/ROWS;
+	for (p=0; p<PAGES; p++) {
+		if (!(pagemask & (0x01 << p))) continue;
+		if (q <= p*ROWSPERPAGE) himask = 0xFF;
+		else if (q >= (p+1)*ROWSPERPAGE) himask = 0x00;
+		else himask = 0xFF << (q-p*ROWSPERPAGE);
+
+		lo = (const uint8_t *)c->bits+(size_t)(cyc*PAGES+p)*c->w+x0;
+		hi = lo+(size_t)PAGES*c->w;
+		for (col=0; col<COLUMNS; col++) {
+			c->gram[p][col] = (himask ? lo[col] & himask : 0) |
+			                  (himask != 0xFF ? hi[col] & ~himask : 0);
+		}
+	}
+
+	prevfb = oledgetfb();
+	oledsetfb((char *)c->gram);
+	i = oledflushpages(pi, fd, pagemask);
+	oledsetfb(prevfb);
+	if (i != 0) return(i);
+
+	c->vx = x0;
+	c->vy = y0;
+	return(oledstartline(pi, fd, q));
+}
@@ -0,0 +1,163 @@
+/******************************************************************************/
+/*                                                                            */
+/* Strip charts and sparklines for the                                        */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A chart is a rectangle of the framebuffer showing the last w samples of a  */
+/* value, newest in the right hand column, kept in a ring. Adding a sample    */
+/* doesn't redraw the plot: the rectangle is moved one column left (a         */
+/* memmove() along each page it covers, masked on the pages it only partly    */
+/* fills), the new column is drawn and only the rectangle is flushed - so a   */
+/* sample costs the same however long the chart has been running.             */
+/*                                                                            */
+/*      struct oledchart c;                                                   */
+/*      oledchartinit(&c,1,1,128,40,0.0,100.0,OLEDCHARTLINE);                 */
+/*      oledchartredraw(pi,fd,&c,FBANDDISPLAY);                               */
+/*      for (;;) oledchartadd(pi,fd,&c,cpuload(),FBANDDISPLAY);               */
+/*                                                                            */
+/* The chart draws on whatever framebuffer the library is using, so it can    */
+/* live on a layer or a wall tile too.                                        */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+
+int oledchartinit(struct oledchart *c, int x, int y, int w, int h, double lo, double hi, uint8_t style) {
+/******************************************************************************/
+/*                                                                            */
+/* Set up an empty chart w pixels wide and h high with its bottom left pixel  */
+/* at (x,y). Samples of lo or less are drawn on its bottom row, hi or more on */
+/* its top row. style is OLEDCHARTLINE (each sample joined to the one         */
+/* before), OLEDCHARTBAR (filled down to the bottom row) or OLEDCHARTDOT.     */
+/* Nothing is drawn - oledchartredraw() clears the rectangle.                 */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK((w < 1) || (h < 1) || !(hi > lo) || (style > OLEDCHARTDOT), BADIMAGE);
+	OLEDCHECK((x < ORIGIN) || (x+w > COLUMNS+ORIGIN), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y+h > ROWS+ORIGIN), ROWOUTOFRANGE);
+
+	memset(c, 0, sizeof(*c));
+	c->x = x;
+	c->y = y;
+	c->w = w;
+	c->h = h;
+	c->lo = lo;
+	c->hi = hi;
+	c->style = style;
+	return(0);
+}
+
+static int oledchartrow(const struct oledchart *c, double v) {
+	// The row of the chart (0 at the bottom) a value is drawn on
+	double r = (v-c->lo)*(c->h-1)/(c->hi-c->lo)+0.5;
+
+	if (!(r >= 0)) return(0);       // Below the range, or NaN
+	if (r > c->h-1) return(c->h-1);
+	return((int)r);
+}
+
+static uint8_t oledchartmask(const struct oledchart *c, int page, int r0, int r1) {
+	// The bits of page covering chart rows r0 to r1
+	int b0 = c->y-ORIGIN+r0-page*ROWSPERPAGE, b1 = c->y-ORIGIN+r1-page*ROWSPERPAGE;
+
+	if (b0 < 0) b0 = 0;
+	if (b1 > ROWSPERPAGE-1) b1 = ROWSPERPAGE-1;
+	if (b0 > b1) return(0);
+	return((0xFF << b0) & (0xFF >> (ROWSPERPAGE-1-b1)));
+}
+
+static void oledchartcol(const struct oledchart *c, char *fb, int col, int prev, int row) {
+	// Draw one sample in column col (framebuffer column, 0 based)
+	int r0 = row, r1 = row, p;
+
+	if (c->style == OLEDCHARTBAR) r0 = 0;
+	else if ((c->style == OLEDCHARTLINE) && (prev >= 0)) {
+		if (prev < r0) r0 = prev;
+		if (prev > r1) r1 = prev;
+	}
+
+	for (p=(c->y-ORIGIN+r0)/ROWSPERPAGE; p<=(c->y-ORIGIN+r1)/ROWSPERPAGE; p++)
+		fb[p*COLUMNS+col] |= oledchartmask(c, p, r0, r1);
+}
+
+int oledchartadd(int pi, int fd, struct oledchart *c, double v, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Add a sample: move the plot one column left, losing the oldest sample off  */
+/* the left hand edge, and draw v in the right hand column. With              */
+/* FBANDDISPLAY only the chart's rectangle is sent. Returns 0, INVALIDFBCODE  */
+/* or a pigpiod error.                                                        */
+/*                                                                            */
+/******************************************************************************/
+	char *fb = oledgetfb(), *b;
+	int p, p0, p1, k, x0, prev;
+	uint8_t m;
+
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	prev = (c->count > 0) ? oledchartrow(c, c->ring[(c->head+c->w)%(c->w+1)]) : -1;
+	c->ring[c->head] = v;
+	c->head = (c->head+1)%(c->w+1);
+	if (c->count <= c->w) c->count++;
+	c->samples++;
+
+	// Move the rectangle left a column, page by page, and blank the new column
+	x0 = c->x-ORIGIN;
+	p0 = (c->y-ORIGIN)/ROWSPERPAGE;
+	p1 = (c->y-ORIGIN+c->h-1)/ROWSPERPAGE;
+	for (p=p0; p<=p1; p++) {
+		b = fb+p*COLUMNS+x0;
+		m = oledchartmask(c, p, 0, c->h-1);
+		if (m == 0xFF) memmove(b, b+1, c->w-1);
+		else for (k=0; k<c->w-1; k++) b[k] = (b[k] & ~m) | (b[k+1] & m);
+		b[c->w-1] &= ~m;
+	}
+
+	oledchartcol(c, fb, x0+c->w-1, prev, oledchartrow(c, v));
+
+	if (fbwrite == FBANDDISPLAY) return(oledflushrect(pi, fd, c->x, c->y, c->w, c->h));
+	return(0);
+}
+
+int oledchartredraw(int pi, int fd, struct oledchart *c, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Clear the chart's rectangle and draw every sample in the ring again. Call  */
+/* it to draw the chart the first time, after lo, hi or style are changed, or */
+/* if something else has drawn over the rectangle. Returns 0, INVALIDFBCODE   */
+/* or a pigpiod error.                                                        */
+/*                                                                            */
+/******************************************************************************/
+	char *fb = oledgetfb();
+	int p, k, n, col, row, prev = -1;
+	uint8_t m;
+
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	for (p=(c->y-ORIGIN)/ROWSPERPAGE; p<=(c->y-ORIGIN+c->h-1)/ROWSPERPAGE; p++) {
+		m = oledchartmask(c, p, 0, c->h-1);
+		for (k=0; k<c->w; k++) fb[p*COLUMNS+c->x-ORIGIN+k] &= ~m;
+	}
+
+	// Oldest sample first, ending in the right hand column. A sample that has
+	// scrolled off is only there for the line to the first one shown to start at.
+	n = (c->head+c->w+1-c->count)%(c->w+1);
+	if (c->count > c->w) {
+		prev = oledchartrow(c, c->ring[n]);
+		n = (n+1)%(c->w+1);
+	}
+	col = c->x-ORIGIN+c->w-((c->count > c->w) ? c->w : c->count);
+	for (; col<c->x-ORIGIN+c->w; col++, n=(n+1)%(c->w+1)) {
+		row = oledchartrow(c, c->ring[n]);
+		oledchartcol(c, fb, col, prev, row);
+		prev = row;
+	}
+
+	if (fbwrite == FBANDDISPLAY) return(oledflushrect(pi, fd, c->x, c->y, c->w, c->h));
+	return(0);
+}
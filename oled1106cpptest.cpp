@@ -0,0 +1,139 @@
+/******************************************************************************/
+/*                                                                            */
+/* C++ wrapper test for the                                                   */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Instantiates each oled::Display kernel (oled1106.hpp) for every pixel      */
+/* operation and flush policy it is used with, and checks that drawing with   */
+/* them leaves the same framebuffer as the equivalent C calls. Off-display    */
+/* points and rectangles are clipped by the wrapper, so the C side draws just */
+/* the parts that fit. FbAndDisplay kernels write to an SH1106 emulator,      */
+/* which must end up showing the framebuffer.                                 */
+/*                                                                            */
+/* 'make test' builds it with -std=c++20 -DOLEDNOPIGPIO and runs it. Exits    */
+/* non-zero on any mismatch.                                                  */
+/*                                                                            */
+/******************************************************************************/
+#include <cstdio>
+#include <cstring>
+#include "oled1106.hpp"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define FBSIZE          1024
+
+static int failures;
+
+static const char text[] = "Caf\xC3\xA9 12\xC2\xB0" "C";   // UTF-8, beyond ASCII
+static const oled::Point pts[] = {{1,1}, {128,64}, {64,32}, {0,5}, {129,1}, {5,0}, {5,65}, {-3,-3}, {70,33}};
+static const uint8_t bits[] = {0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF,    // 8x12, page-major
+                               0x0F, 0x08, 0x0B, 0x0A, 0x0A, 0x0B, 0x08, 0x0F};
+
+static void cpixels(uint8_t mode) {
+	// oledsetpixel() on just the points of pts that are on the display
+	for (const oled::Point &p : pts)
+		if ((p.x >= 1) && (p.x <= COLUMNS) && (p.y >= 1) && (p.y <= ROWS))
+			oledsetpixel(0,0,p.x,p.y,mode,FBONLY);
+}
+
+static void cdraw(void) {
+	// The scene with the C API
+	char buf[sizeof(text)];
+
+	oledclear(0,0,FBONLY);
+	oledsetpixel(0,0,3,4,PIXON,FBONLY);
+	oledsetpixel(0,0,3,4,PIXINV,FBONLY);
+	oledsetpixel(0,0,100,60,PIXON,FBANDDISPLAY);
+	cpixels(PIXON);
+	oledfillrect(0,0,10,10,39,29,PIXON,FBONLY);
+	oledfillrect(0,0,20,5,9,49,PIXINV,FBANDDISPLAY);
+	oledfillrect(0,0,12,12,5,5,PIXOFF,FBONLY);
+	oledfillrect(0,0,100,1,28,10,PIXON,FBONLY);             // Clipped on the right
+	oledfillrect(0,0,1,56,7,8,PIXINV,FBONLY);               // Clipped at top and left
+	oledhorizline(0,0,1,40,127,PIXINV,FBONLY);
+	oledvertline(0,0,90,1,63,PIXON,FBONLY);
+	cpixels(PIXOFF);
+	cpixels(PIXINV);
+	memcpy(buf,text,sizeof(text));
+	oledstr(0,0,buf,8,0,FBANDDISPLAY);
+	oledbitmap(0,0,bits,8,12,60,20,PIXON,FBONLY);
+	oledbitmap(0,0,bits,8,12,124,58,PIXINV,FBANDDISPLAY);  // Clipped
+}
+
+static int cppdraw(oled::Display &d) {
+	// The same scene through the wrapper
+	using oled::Pix;
+	using oled::FbAndDisplay;
+	int i = 0;
+
+	i |= d.clear();
+	i |= d.pixel<Pix::On>(3,4);
+	i |= d.pixel<Pix::Inv>(3,4);
+	i |= d.pixel<Pix::On,FbAndDisplay>(100,60);
+	i |= d.pixels<Pix::On>(pts);
+	i |= d.fillrect<Pix::On>(10,10,40,30);
+	i |= d.fillrect<Pix::Inv,FbAndDisplay>(20,5,10,50);
+	i |= d.fillrect<Pix::Off>(12,12,6,6);
+	i |= d.fillrect<Pix::On>(100,1,40,11);
+	i |= d.fillrect<Pix::Inv>(-4,56,13,20);
+	i |= d.hline<Pix::Inv>(1,40,128);
+	i |= d.vline<Pix::On>(90,1,64);
+	i |= d.pixels<Pix::Off>(pts);
+	i |= d.pixels<Pix::Inv,FbAndDisplay>(pts);
+	i |= d.str<FbAndDisplay>(text,8);
+	i |= d.bitmap<Pix::On>(bits,8,12,60,20);
+	i |= d.bitmap<Pix::Inv,FbAndDisplay>(bits,8,12,124,58);
+	return(i);
+}
+
+static void same(const char *what, const uint8_t *want, const uint8_t *got) {
+	int k;
+
+	for (k=0; (k < FBSIZE) && (want[k] == got[k]); k++);
+	if (k == FBSIZE) return;
+	printf("FAIL %s: differs first at page %d column %d (0x%02X, expected 0x%02X)\n",
+	       what, k/COLUMNS+1, k%COLUMNS+1, got[k], want[k]);
+	++failures;
+}
+
+int main(void) {
+	static struct oledemu emu;
+	static uint8_t want[FBSIZE], shown[FBSIZE];
+	oled::Display d(0,0);
+
+	oledemuinit(&emu, 400000);
+	oledsettransport(oledemuwrite, &emu);
+
+	cdraw();
+	memcpy(want, oledgetfb(), FBSIZE);
+
+	if (d.init() != 0) ++failures;
+	if (cppdraw(d) != 0) {
+		printf("FAIL drawing through oled::Display returned an error\n");
+		++failures;
+	}
+	same("framebuffer", want, d.framebuffer().data());
+
+	// Everything drawn with FbAndDisplay was last, or covered by a later flush
+	if (d.flushrect(1,1,COLUMNS,ROWS) != 0) ++failures;
+	oledemuframe(&emu, (char *)shown);
+	same("emulated display", want, shown);
+
+	// Text clipped at the right hand edge, and the error paths
+	d.clear();
+	if (d.str("Wrapper", 3, 110) != 0) ++failures;
+	if ((d.str("x", 0) != PAGETOOLOW) || (d.str("x", 9) != PAGETOOHIGH) ||
+	    (d.str("x", 1, 129) != COLOUTOFRANGE) ||
+	    (d.bitmap<oled::Pix::On>(std::span<const uint8_t>(bits, 4), 8, 12, 1, 1) != BADIMAGE)) {
+		printf("FAIL bad arguments weren't rejected\n");
+		++failures;
+	}
+	if ((emu.overrun != 0) || (emu.unknown != 0)) {
+		printf("FAIL %ld writes past column 131, %ld unknown commands\n", emu.overrun, emu.unknown);
+		++failures;
+	}
+
+	oledsettransport(NULL, NULL);
+	printf("%s\n", failures ? "C++ wrapper test FAILED" : "C++ wrapper test passed");
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,195 @@
+/******************************************************************************/
+/*                                                                            */
+/* Grayscale to 1bpp conversion for the                                       */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Converts an 8 bit grayscale image of any size into the library's 128x64    */
+/* page-major framebuffer layout, scaling it (nearest neighbour) to fit. The  */
+/* threshold and Bayer ordered paths use NEON on ARM and SSE2 on x86 to do    */
+/* 16 columns at a time; error diffusion is inherently serial and is plain C. */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OLEDNEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OLEDSSE2
+#endif
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+
+/* 8x8 Bayer index matrix. Each entry n becomes the threshold 4n+2, so level  */
+/* 0 is always off, 255 always on and every other level between is distinct.  */
+
+static const uint8_t bayer8[8][8] = { { 0, 32,  8, 40,  2, 34, 10, 42},
+                                      {48, 16, 56, 24, 50, 18, 58, 26},
+                                      {12, 44,  4, 36, 14, 46,  6, 38},
+                                      {60, 28, 52, 20, 62, 30, 54, 22},
+                                      { 3, 35, 11, 43,  1, 33,  9, 41},
+                                      {51, 19, 59, 27, 49, 17, 57, 25},
+                                      {15, 47,  7, 39, 13, 45,  5, 37},
+                                      {63, 31, 55, 23, 61, 29, 53, 21} };
+
+static void threshrow(const uint8_t *line, const uint8_t *thr, uint8_t bit, uint8_t *acc) {
+/******************************************************************************/
+/*                                                                            */
+/* For each of the 128 columns set bit in acc if line is at or above the      */
+/* threshold. thr is a 16 byte pattern repeated across the row (all the same  */
+/* value for plain thresholding, two copies of a Bayer row for ordered).      */
+/*                                                                            */
+/******************************************************************************/
+	int c;
+
+#if defined(OLEDNEON)
+	uint8x16_t t = vld1q_u8(thr);
+	uint8x16_t b = vdupq_n_u8(bit);
+
+	for (c=0; c<COLUMNS; c+=16) {
+		uint8x16_t on = vandq_u8(vcgeq_u8(vld1q_u8(line+c), t), b);
+		vst1q_u8(acc+c, vorrq_u8(vld1q_u8(acc+c), on));
+	}
+#elif defined(OLEDSSE2)
+	__m128i t = _mm_loadu_si128((const __m128i *)thr);
+	__m128i b = _mm_set1_epi8((char)bit);
+
+	for (c=0; c<COLUMNS; c+=16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(line+c));
+		// SSE2 has no unsigned compare - v >= t exactly when max(v,t) == v
+		__m128i on = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v), b);
+		__m128i a = _mm_loadu_si128((const __m128i *)(acc+c));
+		_mm_storeu_si128((__m128i *)(acc+c), _mm_or_si128(a, on));
+	}
+#else
+	for (c=0; c<COLUMNS; c++)
+		acc[c] |= (uint8_t)(-(line[c] >= thr[c & 15])) & bit;
+#endif
+	return;
+}
+
+static const uint8_t *scalerow(const uint8_t *row, int width, const uint16_t *xmap, uint8_t *line) {
+/******************************************************************************/
+/*                                                                            */
+/* Return a 128 pixel version of a source row, using it in place if it is     */
+/* already the right width, otherwise sampling it into line through xmap.     */
+/*                                                                            */
+/******************************************************************************/
+	int c;
+
+	if (width == COLUMNS) return(row);
+	for (c=0; c<COLUMNS; c++) line[c] = row[xmap[c]];
+	return(line);
+}
+
+static void diffuse(const uint8_t *src, int width, int height, int stride,
+                    const uint16_t *xmap, uint8_t method, uint8_t level, uint8_t *fb) {
+/******************************************************************************/
+/*                                                                            */
+/* Error diffusion, a row at a time from the top of the image. Floyd-         */
+/* Steinberg passes all of the error on (7/16 right, 3/16, 5/16, 1/16 below)  */
+/* and runs serpentine to avoid diagonal worms. Atkinson passes on 6/8 of it  */
+/* over two rows, which keeps highlights and shadows cleaner on a small       */
+/* display. Error rows are padded by 2 each side so no edge tests are needed. */
+/*                                                                            */
+/******************************************************************************/
+	int errbuf[3][COLUMNS+4];
+	int *e0=errbuf[0]+2, *e1=errbuf[1]+2, *e2=errbuf[2]+2, *et;
+	int sy, r, c, i, d, v, e;
+	uint8_t line[COLUMNS], bit, *page;
+	const uint8_t *p;
+
+	memset(errbuf, 0, sizeof(errbuf));
+
+	for (sy=0; sy<ROWS; sy++) {
+		r = ROWS-1-sy;                          // Library row 0 is the bottom
+		page = fb+(r/ROWSPERPAGE)*COLUMNS;
+		bit = 0x01 << (r%ROWSPERPAGE);
+		p = scalerow(src+(size_t)(((2*sy+1)*height)/(2*ROWS))*stride, width, xmap, line);
+
+		d = ((method == OLEDFLOYD) && (sy & 1)) ? -1 : 1;
+		for (i=0; i<COLUMNS; i++) {
+			c = (d > 0) ? i : COLUMNS-1-i;
+			v = p[c]+e0[c];
+			if (v >= level) {
+				page[c] |= bit;
+				e = v-255;
+			}
+			else {
+				e = v;
+			}
+			if (method == OLEDFLOYD) {
+				e0[c+d]   += (e*7)/16;
+				e1[c-d]   += (e*3)/16;
+				e1[c]     += (e*5)/16;
+				e1[c+d]   += e/16;
+			}
+			else {
+				e /= 8;
+				e0[c+1] += e;
+				e0[c+2] += e;
+				e1[c-1] += e;
+				e1[c]   += e;
+				e1[c+1] += e;
+				e2[c]   += e;
+			}
+		}
+
+		// Move the error rows up and clear the one that is now furthest away
+		et = e0; e0 = e1; e1 = e2; e2 = et;
+		memset(e2-2, 0, (COLUMNS+4)*sizeof(int));
+	}
+	return;
+}
+
+int oleddither(const uint8_t *src, int width, int height, int stride,
+               uint8_t method, uint8_t level, char *fb) {
+/******************************************************************************/
+/*                                                                            */
+/* Convert the width x height 8 bit grayscale image at src (top row first,    */
+/* stride bytes between rows) into a 128x64 page-major image at fb, or into   */
+/* the current framebuffer if fb is NULL. The image is scaled to fill the     */
+/* display. Method is OLEDTHRESHOLD, OLEDBAYER, OLEDFLOYD or OLEDATKINSON.    */
+/* Level is the grey at which pixels turn on - 128 is neutral for all four    */
+/* methods; for Bayer it shifts the whole threshold matrix up or down.        */
+/* Nothing is sent to the display - call oledflushfb() afterwards.            */
+/*                                                                            */
+/******************************************************************************/
+	int c, sy, r, t;
+	uint16_t xmap[COLUMNS];
+	uint8_t line[COLUMNS], thr[16];
+	uint8_t *out;
+	const uint8_t *p;
+
+	OLEDCHECK((src == NULL) || (width < 1) || (height < 1) || (width > 65535) ||
+	          (stride < width) || (method > OLEDATKINSON), BADIMAGE);
+
+	out = (uint8_t *)((fb == NULL) ? oledgetfb() : fb);
+	memset(out, 0, ROWS/ROWSPERPAGE*COLUMNS);
+
+	// Sample each display column from the middle of its span of source columns
+	for (c=0; c<COLUMNS; c++) xmap[c] = (uint16_t)(((2*c+1)*width)/(2*COLUMNS));
+
+	if (method >= OLEDFLOYD) {
+		diffuse(src, width, height, stride, xmap, method, level, out);
+		return(0);
+	}
+
+	memset(thr, level, sizeof(thr));
+	for (sy=0; sy<ROWS; sy++) {
+		r = ROWS-1-sy;
+		if (method == OLEDBAYER) {
+			for (c=0; c<16; c++) {
+				t = bayer8[sy & 7][c & 7]*4+2+level-128;
+				thr[c] = (uint8_t)(t < 1 ? 1 : (t > 255 ? 255 : t));
+			}
+		}
+		p = scalerow(src+(size_t)(((2*sy+1)*height)/(2*ROWS))*stride, width, xmap, line);
+		threshrow(p, thr, 0x01 << (r%ROWSPERPAGE), out+(r/ROWSPERPAGE)*COLUMNS);
+	}
+
+	return(0);
+}
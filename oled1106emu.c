@@ -0,0 +1,248 @@
+/******************************************************************************/
+/*                                                                            */
+/* SH1106 controller emulator for the                                         */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* oledemuwrite() is a transport for oledsettransport(). Instead of going to  */
+/* pigpiod, each I2C write is decoded the way the controller would decode it  */
+/* - control bytes (Co and D/C bits), column low/high nibbles, page address,  */
+/* start line, display offset, multiplex ratio, segment remap, COM scan       */
+/* direction, contrast, normal/reverse video, entire display on and display   */
+/* on/off - into an emulated 132x64 display RAM. oledemupixel() and           */
+/* oledemuframe() then give what the panel would show, so command streams can */
+/* be checked against golden images on any Linux box, and oledemupbm() saves  */
+/* it as a picture.                                                           */
+/*                                                                            */
+/* The bus is timed in SCL cycles: a write of n bytes is a START, the address */
+/* byte and n data bytes of 9 clocks each (8 bits and the ACK) and a STOP, so */
+/* oledemuseconds() is what the traffic would have taken on a real bus at the */
+/* emulator's clock speed (plus any fixed cost per write put in gapns).       */
+/*                                                                            */
+/*      struct oledemu e;                                                     */
+/*      oledemuinit(&e,400000);                                               */
+/*      oledsettransport(oledemuwrite,&e);                                    */
+/*      oledinit(0,0);                                                        */
+/*                                                                            */
+/* The panel is modelled as these modules are wired: 128 columns on segments  */
+/* 2 to 129 and, with the library's default 0xA1/0xC0 orientation, column     */
+/* address 2 on the left and the start line on the bottom row.                */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+#define COLOFFSET       2       // Visible columns start at column address 2.
+#define RAMCOLUMNS      132     // Columns of display RAM.
+
+int oledemuinit(struct oledemu *e, long hz) {
+/******************************************************************************/
+/*                                                                            */
+/* Put the emulator in the controller's power on reset state (display off,    */
+/* start line, offset and addresses 0, contrast 0x80, no remap) with a clear  */
+/* display RAM, and set the I2C bus clock to hz (400kHz if hz <= 0).          */
+/*                                                                            */
+/******************************************************************************/
+
+	memset(e, 0, sizeof(*e));
+	e->rmwcol = -1;
+	e->mux = ROWS-1;
+	e->contrast = 0x80;
+	e->hz = (hz > 0) ? hz : 400000;
+
+	return(0);
+}
+
+static void oledemucmd(struct oledemu *e, uint8_t b) {
+	// One command byte. Commands with an argument leave e->cmd set until it arrives
+	e->commands++;
+
+	if (e->cmd != 0) {
+		switch (e->cmd) {
+		case 0x81: e->contrast = b; break;
+		case 0xA8: e->mux = b & 0x3F; break;
+		case 0xD3: e->offset = b & 0x3F; break;
+		default: break;                 // Clock, precharge, pads, VCOM, DC-DC
+		}
+		e->cmd = 0;
+		return;
+	}
+
+	if (b <= 0x0F) e->col = (e->col & 0xF0) | b;
+	else if (b <= 0x1F) e->col = (e->col & 0x0F) | ((b & 0x0F) << 4);
+	else if ((b >= 0x30) && (b <= 0x33)) ;          // Pump voltage
+	else if ((b >= 0x40) && (b <= 0x7F)) e->startline = b-0x40;
+	else if ((b >= 0xB0) && (b <= 0xBF)) e->page = b & 0x07;
+	else if ((b >= 0xC0) && (b <= 0xCF)) e->comscan = (b & 0x08) != 0;
+	else switch (b) {
+	case 0x81: case 0xA8: case 0xD3: case 0xD5:
+	case 0xD9: case 0xDA: case 0xDB: case 0xAD:
+		e->cmd = b;
+		break;
+	case 0xA0: case 0xA1: e->segremap = b & 0x01; break;
+	case 0xA4: case 0xA5: e->allon = b & 0x01; break;
+	case 0xA6: case 0xA7: e->inverse = b & 0x01; break;
+	case 0xAE: case 0xAF: e->on = b & 0x01; break;
+	case 0xE0: e->rmwcol = e->col; break;   // Read-modify-write start ...
+	case 0xEE:                              // ... and end, column put back
+		if (e->rmwcol >= 0) e->col = e->rmwcol;
+		e->rmwcol = -1;
+		break;
+	case 0xE3: break;                       // NOP
+	default: e->unknown++; break;
+	}
+	return;
+}
+
+static void oledemudata(struct oledemu *e, uint8_t b) {
+	// One display data byte at the current page and column, which then moves on
+	e->data++;
+	if (e->col < RAMCOLUMNS) {
+		e->gram[e->page][e->col] = b;
+		e->col++;
+	}
+	else e->overrun++;                      // Past column 131 - lost
+	return;
+}
+
+int oledemuwrite(void *ctx, int pi, int fd, char *buf, unsigned len) {
+/******************************************************************************/
+/*                                                                            */
+/* Transport for oledsettransport(), ctx being a struct oledemu. Decodes one  */
+/* I2C write: a control byte with Co=1 applies to the single byte after it,   */
+/* and another control byte follows; Co=0 makes the rest of the write         */
+/* commands (D/C=0) or display data (D/C=1). pi and fd are ignored. Returns 0 */
+/* like i2c_write_device().                                                   */
+/*                                                                            */
+/******************************************************************************/
+	struct oledemu *e = ctx;
+	const uint8_t *b = (const uint8_t *)buf;
+	unsigned i = 0;
+	uint8_t ctl;
+
+	e->writes++;
+	e->bytes += len;
+	e->scl += 2+9*(1+(int64_t)len);         // START, address, bytes, STOP
+
+	while (i < len) {
+		ctl = b[i++];
+		if (ctl & 0x80) {                       // Co=1: one byte, then a control byte
+			if (i == len) break;
+			if (ctl & 0x40) oledemudata(e, b[i++]);
+			else oledemucmd(e, b[i++]);
+		}
+		else {                                  // Co=0: the rest of the write
+			for (; i<len; i++) {
+				if (ctl & 0x40) oledemudata(e, b[i]);
+				else oledemucmd(e, b[i]);
+			}
+		}
+	}
+
+	return(0);
+}
+
+int oledemupixel(const struct oledemu *e, int x, int y) {
+/******************************************************************************/
+/*                                                                            */
+/* 1 if the panel pixel at (x,y), (1,1) bottom left, is lit, 0 if not. The    */
+/* COM line on that row is found from the scan direction, the display RAM row */
+/* from the start line and offset, and the column address from the segment    */
+/* remap; display off, entire display on and reverse video are then applied.  */
+/* Returns COLOUTOFRANGE or ROWOUTOFRANGE for a pixel off the panel.          */
+/*                                                                            */
+/******************************************************************************/
+	int com, row, col;
+
+	OLEDCHECK((x < ORIGIN) || (x > COLUMNS+ORIGIN-1), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y > ROWS+ORIGIN-1), ROWOUTOFRANGE);
+
+	if (!e->on) return(0);
+
+	com = e->comscan ? ROWS-1-(y-ORIGIN) : y-ORIGIN;
+	if (com > e->mux) return(0);            // Beyond the multiplex ratio - not driven
+	if (e->allon) return(1);
+
+	row = (com+e->offset+e->startline) % ROWS;
+	col = e->segremap ? (x-ORIGIN)+COLOFFSET : RAMCOLUMNS-1-COLOFFSET-(x-ORIGIN);
+
+	return(((e->gram[row/ROWSPERPAGE][col] >> (row%ROWSPERPAGE)) & 0x01) ^ e->inverse);
+}
+
+void oledemuframe(const struct oledemu *e, char *fb) {
+/******************************************************************************/
+/*                                                                            */
+/* Fill fb (1024 bytes) with what the panel shows, in the framebuffer's       */
+/* layout, so a stream can be checked with memcmp(fb,oledgetfb(),1024) or     */
+/* against a stored golden image.                                             */
+/*                                                                            */
+/******************************************************************************/
+	int x, y;
+
+	memset(fb, 0, COLUMNS*ROWS/ROWSPERPAGE);
+	for (y=0; y<ROWS; y++)
+		for (x=0; x<COLUMNS; x++)
+			if (oledemupixel(e, x+ORIGIN, y+ORIGIN) == 1)
+				fb[(y/ROWSPERPAGE)*COLUMNS+x] |= 0x01 << (y%ROWSPERPAGE);
+	return;
+}
+
+int oledemupbm(const struct oledemu *e, const char *path) {
+/******************************************************************************/
+/*                                                                            */
+/* Save what the panel shows as a binary (P4) PBM file, top row first. Lit    */
+/* pixels are 1 bits, which most viewers show black on white. Returns 0, or   */
+/* -1 (errno set) if the file can't be written.                               */
+/*                                                                            */
+/******************************************************************************/
+	FILE *f;
+	uint8_t line[COLUMNS/8];
+	int x, y, i;
+
+	f = fopen(path, "wb");
+	if (f == NULL) return(-1);
+
+	fprintf(f, "P4\n%d %d\n", COLUMNS, ROWS);
+	for (y=ROWS; y>=ORIGIN; y--) {
+		memset(line, 0, sizeof(line));
+		for (x=0; x<COLUMNS; x++)
+			if (oledemupixel(e, x+ORIGIN, y) == 1) line[x/8] |= 0x80 >> (x%8);
+		fwrite(line, 1, sizeof(line), f);
+	}
+
+	i = ferror(f);
+	if ((fclose(f) != 0) || i) return(-1);
+	return(0);
+}
+
+double oledemuseconds(const struct oledemu *e) {
+/******************************************************************************/
+/*                                                                            */
+/* The time the writes so far would have taken on the bus: SCL cycles at the  */
+/* emulator's clock (hz may be changed at any time to rescale), plus gapns    */
+/* for each write.                                                            */
+/*                                                                            */
+/******************************************************************************/
+
+	return((double)e->scl/e->hz+e->writes*(e->gapns/1e9));
+}
+
+void oledemureport(const struct oledemu *e, FILE *f) {
+/******************************************************************************/
+/*                                                                            */
+/* Print the emulator's traffic counts, bus time and the controller state.    */
+/*                                                                            */
+/******************************************************************************/
+
+	fprintf(f, "%ld writes, %ld bytes (%ld commands, %ld data), %.2fms on a %ldkHz bus\n",
+	        e->writes, e->bytes, e->commands, e->data, 1e3*oledemuseconds(e), e->hz/1000);
+	fprintf(f, "display %s%s%s, contrast 0x%02X, start line %d, offset %d, mux %d, remap %c, scan %s\n",
+	        e->on ? "on" : "off", e->inverse ? ", reverse" : "", e->allon ? ", all on" : "",
+	        e->contrast, e->startline, e->offset, e->mux+1, e->segremap ? '1' : '0',
+	        e->comscan ? "C8" : "C0");
+	if (e->overrun || e->unknown)
+		fprintf(f, "%ld data bytes past column 131, %ld unknown commands\n", e->overrun, e->unknown);
+	return;
+}
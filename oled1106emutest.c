@@ -0,0 +1,116 @@
+/******************************************************************************/
+/*                                                                            */
+/* Golden image test for the                                                  */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Draws a fixed scene through the SH1106 emulator (oled1106emu.c), each      */
+/* primitive sending only its own part of the display, and checks that:       */
+/*                                                                            */
+/* - the emulated display RAM matches the framebuffer, and                    */
+/* - the panel image saved by oledemupbm() matches oled1106golden0.pbm, and   */
+/*   after oledrotate() to 90 degrees matches oled1106golden90.pbm.           */
+/*                                                                            */
+/* A differing image is left in oled1106emutest0.pbm or oled1106emutest90.pbm */
+/* to look at. After a deliberate change to what is drawn, run it with -w to  */
+/* write new golden images. 'make test' builds it with -DOLEDNOPIGPIO and     */
+/* runs it; it exits non-zero on any mismatch.                                */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define PBMSIZE         4096    // Larger than a 128x64 P4 file
+
+static int failures;
+
+static long readfile(const char *path, char *buf, long len) {
+	FILE *f = fopen(path, "rb");
+	long n;
+
+	if (f == NULL) return(-1);
+	n = (long)fread(buf, 1, len, f);
+	fclose(f);
+	return(n);
+}
+
+static void golden(const struct oledemu *e, const char *name, const char *out, int rewrite) {
+	// Compare what the panel shows with a golden image, or replace it
+	static char want[PBMSIZE], got[PBMSIZE];
+	long nw, ng;
+
+	if (oledemupbm(e, rewrite ? name : out) != 0) {
+		perror(rewrite ? name : out);
+		++failures;
+		return;
+	}
+	if (rewrite) {
+		printf("Wrote %s\n", name);
+		return;
+	}
+
+	nw = readfile(name, want, sizeof(want));
+	ng = readfile(out, got, sizeof(got));
+	if (nw < 0) {
+		printf("FAIL %s: can't be read (run with -w to create it)\n", name);
+		++failures;
+	}
+	else if ((nw != ng) || (memcmp(want, got, nw) != 0)) {
+		printf("FAIL %s: display differs, see %s\n", name, out);
+		++failures;
+	}
+	else remove(out);
+}
+
+static void matchfb(const struct oledemu *e, const char *what) {
+	// The emulated display RAM must hold the framebuffer
+	char shown[COLUMNS*ROWS/8];
+
+	oledemuframe(e, shown);
+	if (memcmp(shown, oledgetfb(), sizeof(shown)) == 0) return;
+	printf("FAIL %s: emulated display differs from framebuffer\n", what);
+	++failures;
+}
+
+int main(int argc, char *argv[]) {
+	static struct oledemu emu;
+	static const int star[] = {64,60, 70,44, 86,44, 73,34, 78,18, 64,28, 50,18, 55,34, 42,44, 58,44};
+	int rewrite = (argc > 1) && (strcmp(argv[1], "-w") == 0);
+	int i = 0, x;
+
+	oledemuinit(&emu, 400000);
+	oledsettransport(oledemuwrite, &emu);
+	i |= oledinit(0,0);
+	matchfb(&emu, "oledinit");
+
+	// Every primitive updates the display itself - no full flush at the end
+	i |= oledstr(0,0,"Golden image",8,0,FBANDDISPLAY);
+	i |= oledrectangle(0,0,1,1,127,55,PIXON,FBANDDISPLAY);
+	i |= oledcircle(0,0,22,28,16,PIXON,FBANDDISPLAY);
+	i |= oledfillcircle(0,0,22,28,8,PIXON,FBANDDISPLAY);
+	i |= oledfillpoly(0,0,star,10,PIXON,FBANDDISPLAY);
+	i |= oledfilltri(0,0,92,6,124,6,108,40,PIXINV,FBANDDISPLAY);
+	i |= oledstrscaled(0,0,"2x",2,96,40,PIXINV,FBANDDISPLAY);
+	for (x=3; x<126; x+=4) i |= oledsetpixel(0,0,x,3,PIXON,FBANDDISPLAY);
+	if (i != 0) {
+		printf("FAIL drawing the scene returned an error\n");
+		++failures;
+	}
+	matchfb(&emu, "scene");
+	golden(&emu, "oled1106golden0.pbm", "oled1106emutest0.pbm", rewrite);
+
+	// Turned, only the middle 64 columns fit on the display
+	if (oledrotate(0,0,OLEDROT90,0) != 0) ++failures;
+	golden(&emu, "oled1106golden90.pbm", "oled1106emutest90.pbm", rewrite);
+	if (oledrotate(0,0,OLEDROT0,0) != 0) ++failures;
+	matchfb(&emu, "back to 0 degrees");
+
+	if ((emu.overrun != 0) || (emu.unknown != 0)) {
+		printf("FAIL %ld writes past column 131, %ld unknown commands\n", emu.overrun, emu.unknown);
+		++failures;
+	}
+
+	oledsettransport(NULL, NULL);
+	printf("%s\n", failures ? "Golden image test FAILED" : "Golden image test passed");
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,159 @@
+/******************************************************************************/
+/*                                                                            */
+/* Font header for the                                                        */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Included by oled1106.c, where the table is const, and by oled1106.hpp,     */
+/* where it is constexpr so C++ can build derived tables at compile time.     */
+/*                                                                            */
+/******************************************************************************/
+#ifndef OLED1106FONT_H
+#define OLED1106FONT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#define OLEDFONTCONST   constexpr
+#else
+#define OLEDFONTCONST   const
+#endif
+
+/* A simple SH1106 font - a 7x7(ish) font on an 8x8 grid. */
+/* Uses printing 'ASCII' codes 32-127.                    */
+/* Note - the characters are mirror images due to         */
+/* a cockup when defining them. The oledstr()             */
+/* function takes care of this ...                        */
+
+static OLEDFONTCONST uint8_t oledf8x8[96][8] = { {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},     //  32 Space
+                                                 {0x00, 0x00, 0x00, 0x7a, 0x7a, 0x00, 0x00, 0x00},     //  33 !
+                                                 {0x00, 0x00, 0x60, 0x00, 0x00, 0x60, 0x00, 0x00},     //  34 "
+                                                 {0x00, 0x24, 0x7e, 0x24, 0x24, 0x7e, 0x24, 0x00},     //  35 #
+                                                 {0x00, 0x4c, 0x52, 0xff, 0xff, 0x52, 0x22, 0x00},     //  36 $
+                                                 {0x00, 0x0c, 0x52, 0x32, 0x7c, 0x98, 0x94, 0x60},     //  37 %
+                                                 {0x00, 0x42, 0x84, 0x8c, 0x92, 0x72, 0x12, 0x0c},     //  38 &
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x00},     //  39 '
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x44, 0x38},     //  40 (
+                                                 {0x00, 0x38, 0x44, 0x82, 0x00, 0x00, 0x00, 0x00},     //  41 )
+                                                 {0x00, 0x92, 0x54, 0x38, 0xfe, 0x38, 0x54, 0x92},     //  42 *
+                                                 {0x00, 0x10, 0x10, 0x10, 0xfe, 0x10, 0x10, 0x10},     //  43 +
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0a, 0x00},     //  44 ,
+                                                 {0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},     //  45 -
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c, 0x00},     //  46 .
+                                                 {0x00, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02},     //  47 slash
+                                                 {0x00, 0x7c, 0xc2, 0xa2, 0x92, 0x8a, 0x86, 0x7c},     //  48 0
+                                                 {0x00, 0x02, 0x02, 0x02, 0xfe, 0x42, 0x22, 0x02},     //  49 1
+                                                 {0x00, 0x62, 0x92, 0x92, 0x92, 0x92, 0x92, 0x4e},     //  50 2
+                                                 {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x82, 0x44},     //  51 3
+                                                 {0x00, 0x08, 0x08, 0x08, 0x7e, 0x08, 0x08, 0xf0},     //  52 4
+                                                 {0x00, 0x8c, 0x92, 0x92, 0x92, 0x92, 0x92, 0xf2},     //  53 5
+                                                 {0x00, 0x4c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x7e},     //  54 6
+                                                 {0x00, 0x80, 0xc0, 0xa0, 0x90, 0x88, 0x84, 0x82},     //  55 7
+                                                 {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x6c},     //  56 8
+                                                 {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x62},     //  57 9
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x6c, 0x6c, 0x00},     //  58 :
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x6c, 0x6a, 0x00},     //  59 ;
+                                                 {0x00, 0x00, 0x00, 0x00, 0x82, 0x44, 0x28, 0x10},     //  60 <
+                                                 {0x00, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x00},     //  61 =
+                                                 {0x00, 0x10, 0x28, 0x44, 0x82, 0x00, 0x00, 0x00},     //  62 >
+                                                 {0x00, 0x00, 0x70, 0x90, 0x9a, 0x80, 0x60, 0x00},     //  63 ?
+                                                 {0x00, 0x44, 0xb2, 0xaa, 0xaa, 0x92, 0x42, 0x3c},     //  64 @
+                                                 {0x00, 0x7e, 0x90, 0x90, 0x90, 0x90, 0x90, 0x7e},     //  65 A
+                                                 {0x00, 0x6c, 0x92, 0x92, 0x92, 0x92, 0x92, 0xfe},     //  66 B
+                                                 {0x00, 0x44, 0x82, 0x82, 0x82, 0x82, 0x82, 0x7c},     //  67 C
+                                                 {0x00, 0x38, 0x44, 0x82, 0x82, 0x82, 0x82, 0xfe},     //  68 D
+                                                 {0x00, 0x82, 0x92, 0x92, 0x92, 0x92, 0x92, 0xfe},     //  69 E
+                                                 {0x00, 0x80, 0x90, 0x90, 0x90, 0x90, 0x90, 0xfe},     //  70 F
+                                                 {0x00, 0x5c, 0x92, 0x92, 0x92, 0x82, 0x42, 0x3c},     //  71 G
+                                                 {0x00, 0xfe, 0x10, 0x10, 0x10, 0x10, 0x10, 0xfe},     //  72 H
+                                                 {0x00, 0x82, 0x82, 0x82, 0xfe, 0x82, 0x82, 0x82},     //  73 I
+                                                 {0x00, 0x80, 0x80, 0xfe, 0x82, 0x82, 0x82, 0x04},     //  74 J
+                                                 {0x00, 0x02, 0x86, 0x4c, 0x38, 0x10, 0x10, 0xfe},     //  75 K
+                                                 {0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0xfe},     //  76 L
+                                                 {0x00, 0xfe, 0x40, 0x20, 0x10, 0x20, 0x40, 0xfe},     //  77 M
+                                                 {0x00, 0xfe, 0x04, 0x08, 0x10, 0x20, 0x40, 0xfe},     //  78 N
+                                                 {0x00, 0x7c, 0x82, 0x82, 0x82, 0x82, 0x82, 0x7c},     //  79 O
+                                                 {0x00, 0x60, 0x90, 0x90, 0x90, 0x90, 0x90, 0xfe},     //  80 P
+                                                 {0x00, 0x7a, 0x84, 0x8a, 0x82, 0x82, 0x82, 0x7e},     //  81 Q
+                                                 {0x00, 0x62, 0x94, 0x98, 0x90, 0x90, 0x90, 0xfe},     //  82 R
+                                                 {0x00, 0x4c, 0x92, 0x92, 0x92, 0x92, 0x92, 0x64},     //  83 S
+                                                 {0x00, 0x80, 0x80, 0x80, 0xfe, 0x80, 0x80, 0x80},     //  84 T
+                                                 {0x00, 0xfc, 0x02, 0x02, 0x02, 0x02, 0x02, 0xfc},     //  85 U
+                                                 {0x00, 0xf0, 0x08, 0x04, 0x02, 0x04, 0x08, 0xf0},     //  86 V
+                                                 {0x00, 0xfe, 0x04, 0x08, 0x10, 0x08, 0x04, 0xfe},     //  87 W
+                                                 {0x00, 0x82, 0x44, 0x28, 0x10, 0x28, 0x44, 0x82},     //  88 X
+                                                 {0x00, 0x80, 0x40, 0x20, 0x1e, 0x20, 0x40, 0x80},     //  89 Y
+                                                 {0x00, 0x82, 0xc2, 0xa2, 0x92, 0x8a, 0x86, 0x82},     //  90 Z
+                                                 {0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x82, 0xfe},     //  91 [
+                                                 {0x00, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80},     //  92 backslash
+                                                 {0x00, 0xfe, 0x82, 0x82, 0x00, 0x00, 0x00, 0x00},     //  93 ]
+                                                 {0x00, 0x00, 0x20, 0x40, 0x80, 0x40, 0x20, 0x00},     //  94 ^
+                                                 {0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01},     //  95 _
+                                                 {0x00, 0x00, 0x00, 0x00, 0x20, 0x40, 0x80, 0x00},     //  96 backquote
+                                                 {0x00, 0x36, 0x4c, 0x4a, 0x4a, 0x4a, 0x2a, 0x04},     //  97 a
+                                                 {0x00, 0x0c, 0x12, 0x12, 0x12, 0x12, 0x0a, 0xfe},     //  98 b
+                                                 {0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c},     //  99 c
+                                                 {0x00, 0xfe, 0x12, 0x12, 0x12, 0x12, 0x0c, 0x00},     // 100 d
+                                                 {0x00, 0x00, 0x34, 0x52, 0x52, 0x52, 0x52, 0x3c},     // 101 e
+                                                 {0x00, 0x00, 0x80, 0x80, 0xa0, 0xa0, 0x7e, 0x20},     // 102 f
+                                                 {0x00, 0x3e, 0x49, 0x49, 0x49, 0x32, 0x00, 0x00},     // 103 g
+                                                 {0x00, 0x00, 0x1e, 0x10, 0x10, 0x10, 0xfe, 0x00},     // 104 h
+                                                 {0x00, 0x00, 0x00, 0x02, 0x5c, 0x00, 0x00, 0x00},     // 105 i
+                                                 {0x00, 0x00, 0x00, 0x5e, 0x01, 0x01, 0x00, 0x00},     // 106 j
+                                                 {0x00, 0x00, 0x00, 0x02, 0x24, 0x18, 0xfe, 0x00},     // 107 k
+                                                 {0x00, 0x00, 0x00, 0x02, 0xfc, 0x00, 0x00, 0x00},     // 108 l
+                                                 {0x00, 0x0e, 0x10, 0x1e, 0x10, 0x10, 0x1e, 0x00},     // 109 m
+                                                 {0x00, 0x00, 0x00, 0x1e, 0x10, 0x10, 0x1e, 0x00},     // 110 n
+                                                 {0x00, 0x00, 0x00, 0x1c, 0x22, 0x22, 0x1c, 0x00},     // 111 o
+                                                 {0x00, 0x00, 0x00, 0x30, 0x48, 0x48, 0x3f, 0x00},     // 112 p
+                                                 {0x00, 0x00, 0x00, 0x3f, 0x48, 0x48, 0x30, 0x00},     // 113 q
+                                                 {0x00, 0x00, 0x10, 0x20, 0x20, 0x10, 0x3e, 0x00},     // 114 r
+                                                 {0x00, 0x24, 0x4a, 0x52, 0x52, 0x52, 0x24, 0x00},     // 115 s
+                                                 {0x00, 0x00, 0x22, 0x22, 0xfc, 0x20, 0x00, 0x00},     // 116 t
+                                                 {0x00, 0x38, 0x04, 0x04, 0x04, 0x38, 0x00, 0x00},     // 117 u
+                                                 {0x00, 0x30, 0x08, 0x04, 0x08, 0x30, 0x00, 0x00},     // 118 v
+                                                 {0x00, 0x00, 0x1c, 0x02, 0x04, 0x02, 0x1c, 0x00},     // 119 w
+                                                 {0x00, 0x00, 0x22, 0x14, 0x08, 0x14, 0x22, 0x00},     // 120 x
+                                                 {0x00, 0x00, 0x7e, 0x11, 0x11, 0x60, 0x00, 0x00},     // 121 y
+                                                 {0x00, 0x00, 0x22, 0x32, 0x2a, 0x26, 0x22, 0x00},     // 122 z
+                                                 {0x00, 0x00, 0x00, 0x00, 0x82, 0x92, 0x7c, 0x10},     // 123 {
+                                                 {0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00},     // 124 |
+                                                 {0x10, 0x7c, 0x92, 0x82, 0x00, 0x00, 0x00, 0x00},     // 125 }
+                                                 {0x00, 0x10, 0x08, 0x08, 0x08, 0x10, 0x10, 0x08},     // 126 ~
+                                                 {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}};    // 127 DEL
+
+/* Glyphs for some code points beyond ASCII, laid out as above, and the runs  */
+/* of consecutive code points they cover, in code point order: first code     */
+/* point, how many, index of the first one's glyph in oledf8x8x. Looked up    */
+/* with oledglyphfind(); U+FFFD is shown for anything else it can't place.    */
+
+static OLEDFONTCONST uint8_t oledf8x8x[17][8] = { {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},     // U+00A0 No-break space
+                                                  {0x00, 0x02, 0x42, 0x82, 0x92, 0x92, 0x7e, 0x12},     // U+00A3 £
+                                                  {0x00, 0x00, 0x00, 0x60, 0x90, 0x90, 0x60, 0x00},     // U+00B0 °
+                                                  {0x00, 0x22, 0x22, 0x22, 0xfa, 0x22, 0x22, 0x22},     // U+00B1 ±
+                                                  {0x00, 0x00, 0x00, 0x48, 0xa8, 0xa8, 0x98, 0x00},     // U+00B2 ²
+                                                  {0x00, 0x00, 0x00, 0x50, 0xa8, 0xa8, 0x88, 0x00},     // U+00B3 ³
+                                                  {0x00, 0x02, 0x3c, 0x06, 0x02, 0x04, 0x3f, 0x00},     // U+00B5 µ
+                                                  {0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00},     // U+00B7 ·
+                                                  {0x00, 0x00, 0x22, 0x14, 0x08, 0x14, 0x22, 0x00},     // U+00D7 ×
+                                                  {0x00, 0x10, 0x10, 0x10, 0x54, 0x10, 0x10, 0x10},     // U+00F7 ÷
+                                                  {0x00, 0x02, 0x00, 0x00, 0x02, 0x00, 0x00, 0x02},     // U+2026 …
+                                                  {0x00, 0x44, 0x82, 0x82, 0xaa, 0xaa, 0x7c, 0x28},     // U+20AC €
+                                                  {0x00, 0x10, 0x10, 0x10, 0x10, 0x54, 0x38, 0x10},     // U+2190 ←
+                                                  {0x00, 0x00, 0x20, 0x40, 0xfe, 0x40, 0x20, 0x00},     // U+2191 ↑
+                                                  {0x00, 0x10, 0x38, 0x54, 0x10, 0x10, 0x10, 0x10},     // U+2192 →
+                                                  {0x00, 0x00, 0x08, 0x04, 0xfe, 0x04, 0x08, 0x00},     // U+2193 ↓
+                                                  {0x00, 0xff, 0x81, 0xb9, 0xab, 0xa1, 0x81, 0xff}};    // U+FFFD Replacement character
+
+static OLEDFONTCONST uint32_t oledf8x8xruns[11][3] = { {0x00A0, 1,  0},
+                                                       {0x00A3, 1,  1},
+                                                       {0x00B0, 4,  2},
+                                                       {0x00B5, 1,  6},
+                                                       {0x00B7, 1,  7},
+                                                       {0x00D7, 1,  8},
+                                                       {0x00F7, 1,  9},
+                                                       {0x2026, 1, 10},
+                                                       {0x20AC, 1, 11},
+                                                       {0x2190, 4, 12},
+                                                       {0xFFFD, 1, 16}};
+
+#endif
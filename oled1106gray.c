@@ -0,0 +1,247 @@
+/******************************************************************************/
+/*                                                                            */
+/* Four level pseudo-grayscale for the                                        */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* The SH1106 is 1 bit per pixel, but alternating two bit-planes quickly      */
+/* enough makes a pixel look grey. Each pixel has a 2 bit level (0-3). A      */
+/* presenter thread shows the high plane for two subframe periods and the     */
+/* low plane for one, so a pixel is lit for (2*high+low)/3 of each cycle.     */
+/*                                                                            */
+/* The cadence must be steady or the greys shimmer, so the presenter sleeps   */
+/* to absolute deadlines with clock_nanosleep() and counts every subframe     */
+/* whose transfer ran into the next one. Only pixels at level 1 or 2 differ   */
+/* between the planes, so oledflushdiff() sends just the columns holding      */
+/* them - what keeps a cycle inside the I2C bus budget.                       */
+/*                                                                            */
+/* Draw into plane[][][] (or with oledgraypixel()/oledgrayimage()), then call */
+/* oledgraycommit() to hand the whole picture to the presenter at the start   */
+/* of its next cycle.                                                         */
+/*                                                                            */
+/******************************************************************************/
+#include <time.h>
+#include <errno.h>
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define PAGES           8       // Display has 8 pages of 8 rows each.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+#define NSPERSEC        1000000000L
+
+static int64_t nsnow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return((int64_t)ts.tv_sec*NSPERSEC+ts.tv_nsec);
+}
+
+static void nsabs(int64_t t, struct timespec *ts) {
+	ts->tv_sec=t/NSPERSEC;
+	ts->tv_nsec=t%NSPERSEC;
+}
+
+int oledgrayinit(struct oledgray *g) {
+/******************************************************************************/
+/*                                                                            */
+/* Set up a grayscale surface with every pixel at level 0 (off).              */
+/*                                                                            */
+/******************************************************************************/
+
+	memset(g, 0, sizeof(*g));
+	pthread_mutex_init(&g->lock, NULL);
+	return(0);
+}
+
+int oledgraypixel(struct oledgray *g, int x, int y, uint8_t level) {
+/******************************************************************************/
+/*                                                                            */
+/* Set pixel (x,y) of the drawing planes to level 0 (off) to 3 (fully on).    */
+/*                                                                            */
+/******************************************************************************/
+	uint8_t bit;
+	int p, col;
+
+	OLEDCHECK(level > 3, BADPIXELCMD);
+	OLEDCHECK((x < ORIGIN) || (x > COLUMNS+ORIGIN-1), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y > ROWS+ORIGIN-1), ROWOUTOFRANGE);
+
+	p = (y-ORIGIN)/ROWSPERPAGE;
+	col = x-ORIGIN;
+	bit = 0x01 << ((y-ORIGIN)%ROWSPERPAGE);
+
+	g->plane[0][p][col] = (level & 1) ? (g->plane[0][p][col] | bit) : (g->plane[0][p][col] & ~bit);
+	g->plane[1][p][col] = (level & 2) ? (g->plane[1][p][col] | bit) : (g->plane[1][p][col] & ~bit);
+
+	return(0);
+}
+
+int oledgrayimage(struct oledgray *g, const uint8_t *src, int width, int height, int stride) {
+/******************************************************************************/
+/*                                                                            */
+/* Fill the drawing planes from an 8 bit grayscale image (top row first,      */
+/* stride bytes between rows), scaled to the display by nearest neighbour.    */
+/* Each pixel is rounded to the nearest of the 4 levels (0, 85, 170, 255).    */
+/*                                                                            */
+/******************************************************************************/
+	int sy, r, c, v;
+	uint8_t bit, *lo, *hi;
+	const uint8_t *row;
+
+	OLEDCHECK((src == NULL) || (width < 1) || (height < 1) || (stride < width), BADIMAGE);
+
+	memset(g->plane, 0, sizeof(g->plane));
+
+	for (sy=0; sy<ROWS; sy++) {
+		r = ROWS-1-sy;                          // Library row 0 is the bottom
+		row = src+(size_t)(((2*sy+1)*height)/(2*ROWS))*stride;
+		lo = g->plane[0][r/ROWSPERPAGE];
+		hi = g->plane[1][r/ROWSPERPAGE];
+		bit = 0x01 << (r%ROWSPERPAGE);
+		for (c=0; c<COLUMNS; c++) {
+			v = (row[((2*c+1)*width)/(2*COLUMNS)]*3+127)/255;
+			if (v & 1) lo[c] |= bit;
+			if (v & 2) hi[c] |= bit;
+		}
+	}
+
+	return(0);
+}
+
+int oledgraycommit(struct oledgray *g) {
+/******************************************************************************/
+/*                                                                            */
+/* Hand the drawing planes to the presenter. It picks them up at the start of */
+/* its next cycle, so a picture is never shown half old, half new.            */
+/*                                                                            */
+/******************************************************************************/
+
+	pthread_mutex_lock(&g->lock);
+	memcpy(g->next, g->plane, sizeof(g->next));
+	g->pending = 1;
+	pthread_mutex_unlock(&g->lock);
+
+	return(0);
+}
+
+static void *presenter(void *arg) {
+/******************************************************************************/
+/*                                                                            */
+/* The real-time loop. Subframe n of a cycle is due at an absolute time, so   */
+/* the time spent flushing never accumulates as drift. A subframe whose       */
+/* flush finishes after the next one was due is a missed deadline; if the     */
+/* loop has fallen a whole subframe behind, the timeline restarts from now    */
+/* rather than flushing back to back to catch up.                             */
+/*                                                                            */
+/******************************************************************************/
+	struct oledgray *g = arg;
+	int64_t period, due, now;
+	struct timespec ts;
+	int step, i, k;
+
+	period = NSPERSEC/g->hz;
+	due = nsnow();
+
+	while (__atomic_load_n(&g->running, __ATOMIC_ACQUIRE)) {
+		for (step=1; step>=0; step--) {         // High plane, then low plane
+			if (step == 1) {
+				pthread_mutex_lock(&g->lock);
+				if (g->pending) {
+					memcpy(g->front, g->next, sizeof(g->front));
+					g->pending = 0;
+				}
+				pthread_mutex_unlock(&g->lock);
+			}
+
+			nsabs(due, &ts);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+			if (g->fresh) {         // Unknown contents - make every byte differ
+				for (k=0; k<PAGES*COLUMNS; k++)
+					g->shadow[k/COLUMNS][k%COLUMNS] = ~g->front[step][k/COLUMNS][k%COLUMNS];
+				g->fresh = 0;
+			}
+			i = oledflushdiff(g->pi, g->fd, (const char *)g->front[step], (char *)g->shadow);
+			if (i < 0) {
+				g->error = i;
+				__atomic_store_n(&g->running, 0, __ATOMIC_RELEASE);
+				return(NULL);
+			}
+			g->bytes += i;
+
+			// The high plane is held for two periods, the low plane for one
+			due += (step == 1) ? 2*period : period;
+			now = nsnow();
+			if (now > due) {
+				__atomic_add_fetch(&g->missed, 1, __ATOMIC_RELAXED);
+				if (now-due > g->worstlate) g->worstlate = now-due;
+				if (now-due >= period) due = now;
+			}
+		}
+		__atomic_add_fetch(&g->cycles, 1, __ATOMIC_RELAXED);
+	}
+
+	return(NULL);
+}
+
+int oledgraystart(int pi, int fd, struct oledgray *g, int hz) {
+/******************************************************************************/
+/*                                                                            */
+/* Start presenting at hz subframes per second (a full grey cycle is 3        */
+/* subframes). Whatever was last committed is shown. While the presenter is   */
+/* running it owns the display: don't flush from any other thread. Returns 0, */
+/* EINVAL if hz is not positive, or the pthread error code if the thread      */
+/* can't be started.                                                          */
+/*                                                                            */
+/******************************************************************************/
+	int i;
+
+	if (hz < 1) return(EINVAL);
+
+	g->pi = pi;
+	g->fd = fd;
+	g->hz = hz;
+	g->cycles = g->missed = g->bytes = 0;
+	g->worstlate = 0;
+	g->error = 0;
+
+	// Whatever is on the display now is unknown - the first flush sends it all
+	g->fresh = 1;
+	memset(g->front, 0, sizeof(g->front));
+
+	g->running = 1;
+	i = pthread_create(&g->thread, NULL, presenter, g);
+	if (i != 0) g->running = 0;
+
+	return(i);
+}
+
+int oledgraystop(struct oledgray *g) {
+/******************************************************************************/
+/*                                                                            */
+/* Stop the presenter once its current cycle ends. The display is left        */
+/* showing one of the planes. Returns the pigpiod error that stopped it       */
+/* early, if any, otherwise 0.                                                */
+/*                                                                            */
+/******************************************************************************/
+
+	__atomic_store_n(&g->running, 0, __ATOMIC_RELEASE);
+	pthread_join(g->thread, NULL);
+	return(g->error);
+}
+
+void oledgrayreport(struct oledgray *g, FILE *f) {
+/******************************************************************************/
+/*                                                                            */
+/* Print the presenter's statistics: cycles shown, missed deadlines, the      */
+/* worst overrun and the average display data sent per cycle.                 */
+/*                                                                            */
+/******************************************************************************/
+	long cycles = __atomic_load_n(&g->cycles, __ATOMIC_RELAXED);
+	long missed = __atomic_load_n(&g->missed, __ATOMIC_RELAXED);
+
+	fprintf(f, "%ld cycles at %d subframes/s, %ld missed deadlines (worst %.2fms late), %ld bytes/cycle\n",
+	        cycles, g->hz, missed, g->worstlate/1e6, cycles ? g->bytes/cycles : 0L);
+	return;
+}
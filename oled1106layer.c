@@ -0,0 +1,171 @@
+/******************************************************************************/
+/*                                                                            */
+/* Layered compositing for the                                                */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Most screens are a fixed frame - borders, labels - with a few values that  */
+/* change. Layers let the two be drawn separately: each layer is a 128x64     */
+/* bitmap in the framebuffer's layout, drawn with the ordinary functions      */
+/* after oledlayerselect(), and oledlayerflush() stacks them into the         */
+/* framebuffer, bottom first, each with its blend: OLEDBLENDOR adds its set   */
+/* pixels, OLEDBLENDXOR inverts them and OLEDBLENDMASK clears them.           */
+/*                                                                            */
+/* The static layers at the bottom of the stack are composited once into a    */
+/* cached base and only done again when one of them is invalidated. The       */
+/* layers above are compared page by page with what they held last time, so   */
+/* only the pages where one of them changed are recomposited - from the base, */
+/* 8 columns at a time as 64 bit words - and sent to the display.             */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define PAGES           8       // The top line of the diplay is on page 8.
+#define WORDS           (COLUMNS/8)     // 64 bit words per page
+
+void oledlayerinit(struct oledlayer *l, uint8_t blend, uint8_t isstatic) {
+/******************************************************************************/
+/*                                                                            */
+/* Set up a blank, visible layer with the given blend (OLEDBLENDOR,           */
+/* OLEDBLENDXOR or OLEDBLENDMASK). isstatic non zero marks a layer that is    */
+/* drawn once: it is only composited again after oledlayerinvalidate().       */
+/*                                                                            */
+/******************************************************************************/
+
+	memset(l, 0, sizeof(*l));
+	l->blend = blend;
+	l->isstatic = isstatic;
+	l->visible = 1;
+	l->invalid = 0xFF;
+	return;
+}
+
+int oledlayersinit(struct oledlayers *ls) {
+/******************************************************************************/
+/*                                                                            */
+/* Set up an empty stack of layers.                                           */
+/*                                                                            */
+/******************************************************************************/
+
+	memset(ls, 0, sizeof(*ls));
+	ls->nbase = -1;
+	return(0);
+}
+
+int oledlayeradd(struct oledlayers *ls, struct oledlayer *l) {
+/******************************************************************************/
+/*                                                                            */
+/* Put a layer on top of the stack. Returns 0, or BADIMAGE if the stack       */
+/* already holds OLEDMAXLAYERS layers or the layer's blend is invalid.        */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK((ls->count == OLEDMAXLAYERS) || (l->blend > OLEDBLENDMASK), BADIMAGE);
+
+	ls->layer[ls->count++] = l;
+	l->invalid = 0xFF;
+	ls->nbase = -1;                         // The stack has changed - rebuild the base
+	return(0);
+}
+
+void oledlayerselect(struct oledlayer *l) {
+/******************************************************************************/
+/*                                                                            */
+/* Make the layer the library's framebuffer, so the drawing functions (with   */
+/* FBONLY) draw on it. oledlayerflush() puts the library back on its own      */
+/* framebuffer, so select a layer again before drawing on it after a flush.   */
+/*                                                                            */
+/******************************************************************************/
+
+	oledsetfb((char *)l->bits);
+	return;
+}
+
+void oledlayerinvalidate(struct oledlayer *l) {
+/******************************************************************************/
+/*                                                                            */
+/* Composite the whole layer again at the next flush. Needed after drawing on */
+/* a static layer, or changing any layer's blend or visibility.               */
+/*                                                                            */
+/******************************************************************************/
+
+	l->invalid = 0xFF;
+	return;
+}
+
+static inline void oledblend(uint64_t *out, const uint64_t *in, uint8_t blend) {
+	// Apply one page of a layer, a word (8 columns) at a time
+	int i;
+
+	if (blend == OLEDBLENDOR) for (i=0; i<WORDS; i++) out[i] |= in[i];
+	else if (blend == OLEDBLENDXOR) for (i=0; i<WORDS; i++) out[i] ^= in[i];
+	else for (i=0; i<WORDS; i++) out[i] &= ~in[i];
+}
+
+int oledlayerflush(int pi, int fd, struct oledlayers *ls, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Composite the stack into the library's framebuffer, redoing only the pages */
+/* that changed, and with FBANDDISPLAY send just those pages. Returns 0,      */
+/* INVALIDFBCODE or a pigpiod error.                                          */
+/*                                                                            */
+/******************************************************************************/
+	struct oledlayer *l;
+	uint64_t out[WORDS];
+	uint8_t pages = 0;
+	int i, k, p, w;
+	char *fb;
+
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	/* The static layers at the bottom of the stack make the cached base */
+
+	for (k=0; (k < ls->count) && ls->layer[k]->isstatic; k++) {
+		pages |= ls->layer[k]->invalid;
+	}
+	if ((pages != 0) || (ls->nbase != k)) {
+		memset(ls->base, 0, sizeof(ls->base));
+		for (i=0; i<k; i++) {
+			l = ls->layer[i];
+			if (l->visible)
+				for (p=0; p<PAGES; p++) oledblend(ls->base+p*WORDS, l->bits+p*WORDS, l->blend);
+			l->invalid = 0;
+		}
+		pages = (ls->nbase != k) ? 0xFF : pages;
+		ls->nbase = k;
+	}
+
+	/* Find the pages the layers above have changed since the last flush */
+
+	for (i=k; i<ls->count; i++) {
+		l = ls->layer[i];
+		pages |= l->invalid;
+		l->invalid = 0;
+		if (l->isstatic) continue;
+		for (p=0; p<PAGES; p++) {
+			if (pages & (0x01 << p)) continue;
+			for (w=p*WORDS; (w < (p+1)*WORDS) && (l->bits[w] == l->prev[w]); w++);
+			if (w < (p+1)*WORDS) pages |= 0x01 << p;
+		}
+	}
+
+	/* Rebuild those pages from the base */
+
+	oledsetfb(NULL);
+	fb = oledgetfb();
+	for (p=0; p<PAGES; p++) {
+		if (!(pages & (0x01 << p))) continue;
+		memcpy(out, ls->base+p*WORDS, sizeof(out));
+		for (i=k; i<ls->count; i++) {
+			l = ls->layer[i];
+			if (l->visible) oledblend(out, l->bits+p*WORDS, l->blend);
+			if (!l->isstatic) memcpy(l->prev+p*WORDS, l->bits+p*WORDS, sizeof(out));
+		}
+		memcpy(fb+p*COLUMNS, out, sizeof(out));
+	}
+	ls->composites++;
+	ls->pages += __builtin_popcount(pages);
+
+	if ((fbwrite == FBONLY) || (pages == 0)) return(0);
+	return(oledflushpages(pi, fd, pages));
+}
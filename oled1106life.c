@@ -4,12 +4,23 @@
 /* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
 /* Tested on a Raspberry Pi 3B+ using the Raspbian Buster operating system.   */
 /*                                                                            */
+/* The simulation runs in its own thread, a few generations ahead of the      */
+/* display, so a generation takes max(compute, flush) rather than the sum.    */
+/* Any outer-totalistic rule can be played, e.g. B36/S23 (HighLife), B2/S     */
+/* (Seeds) or B3678/S34678 (Day & Night). A run ends as soon as the board     */
+/* repeats an earlier generation (a still life or oscillator).                */
+/*                                                                            */
+/* Usage: oled1106life [-d depth] [-r rule]                                   */
+/*   depth is the number of generations that may be queued for display        */
+/*   (default 4), rule is Bx/Sy (default B3/S23, Conway's life).              */
+/*                                                                            */
 /* Prerequisite: PIGPIOD must be installed and running.                       */
 /*                                                                            */
 /* (c) Tim Holyoake, 9th May 2020.                                            */
 /*                                                                            */
 /******************************************************************************/
 #include <time.h>
+#include <pthread.h>
 #include "oled1106.h"
 
 #define PIXOFF          0       // Set pixel off
@@ -21,118 +32,330 @@
 #define COLUMNS         128     // Display has 128 columns of visible pixels.
 #define ROWS            64      // Display has 64 rows of visible pixels.
 #define ORIGIN          1       // Bottom left cell is (1,1).
+#define FBSIZE          1024    // Bytes in a page-major frame
+#define MAXDEPTH        64      // Largest frame ring the user can ask for
+#define NSPERSEC        1000000000L
 
 #define GENMAX 		20000
-#define STABLEMAX 	50
+#define HISTORY         256     // Generations searched for a repeat (longest period found)
+
+static int maxliving, minliving;
+
+/* The simulation and the display run as two pipeline stages joined by a      */
+/* ring of frames. The simulation thread computes generation N+1 while the    */
+/* main thread flushes generation N; when the ring is full the simulation     */
+/* waits (back-pressure), so it is never more than depth generations ahead.   */
+
+static struct {
+	char (*slot)[FBSIZE];
+	int depth, head, tail, count;
+	int eof;                        // The simulation has finished this run
+	pthread_mutex_t lock;
+	pthread_cond_t notfull, notempty;
+} ring = { NULL, 4, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/* Per stage timings for a run */
+
+static struct {
+	int gens, living;
+	int64_t compute, simwait;       // Simulation stage: generating, waiting for space
+	int64_t flush, dispwait;        // Display stage: flushing, waiting for frames
+} stats;
+
+/* The rule is applied two cells at a time through a lookup table. For each   */
+/* column a 3 bit value holds the cells above, on and below the row being     */
+/* computed; four neighbouring columns (12 bits) are all that is needed to    */
+/* decide the two cells in the middle, so the table has 4096 entries of 2     */
+/* bits and a generation has no per-cell branches. Boards are hashed          */
+/* (Zobrist - the XOR of a random key per live cell), updated as cells        */
+/* change, and a run ends when a hash repeats one of the last HISTORY.        */
 
-static int maxliving, minliving, genstable;
+struct game {
+	int columns, rows;
+	uint8_t *board, *next;          // rows*columns cells, 0 or 1, row 0 at the bottom
+	uint16_t birth, survive;        // Bit n set: born / survives with n neighbours
+	uint8_t lut[4096];
+	uint64_t *key;                  // Zobrist key per cell
+	uint64_t hash, history[HISTORY];
+	int period;                     // Of the cycle found, 0 if none
+};
 
-int nextgen(int pi, int fd, void *bd, int columns, int rows)
+static int parserule(const char *rule, uint16_t *birth, uint16_t *survive)
 {
-	int living,x,y,x1,y1,tc,tr;
-	uint8_t ncells; 
-	uint8_t newboard[columns][rows];
-	uint8_t (*board)[rows]= bd;
+	// Accept Bx/Sy (either order, any case); returns -1 if it isn't one
+	uint16_t *set=NULL;
+	int seen=0;
 
-	living=0;
+	*birth=*survive=0;
+	for (; *rule; rule++) {
+		if ((*rule == 'B') || (*rule == 'b')) { set=birth; seen|=1; }
+		else if ((*rule == 'S') || (*rule == 's')) { set=survive; seen|=2; }
+		else if ((*rule >= '0') && (*rule <= '8') && (set != NULL)) *set|=1 << (*rule-'0');
+		else if (*rule != '/') return(-1);
+	}
+	return((seen == 3) ? 0 : -1);
+}
 
-	// Work out what the next generation should look like from the current
-	for (x=0; x<columns; x++) {
-		for (y=0; y<rows; y++) {
-			ncells=0;
-			for(x1=x-1; x1<=x+1; x1++) {
-				for(y1=y-1; y1<=y+1; y1++) {
-                                        tc=(x1+columns)%columns;
-					tr=(y1+rows)%rows;
-					if (board[tc][tr] == PIXON) ++ncells;
-				}
-			}
-			if (board[x][y] == PIXON) --ncells; // Don't count the cell we're examining if it's alive
-			if (ncells == 3 || ((ncells == 2) && (board[x][y] == PIXON))) {
-				newboard[x][y] = PIXON;
-				++living;
-			}
-			else {
-				newboard[x][y] = PIXOFF;
-			}
-			
-			(void) oledsetpixel(pi,fd,x+ORIGIN,y+ORIGIN,newboard[x][y],FBONLY);
+static void buildlut(struct game *g)
+{
+	// Entry i: columns x-1, x, x+1, x+2 are bits 0-2, 3-5, 6-8, 9-11 of i, with
+	// bit 1 of each being the row itself. Result bit 0 is cell x, bit 1 x+1.
+	int i, c[4], k, n, self;
+
+	for (i=0; i<4096; i++) {
+		for (k=0; k<4; k++) c[k]=(i >> (3*k)) & 7;
+		g->lut[i]=0;
+		for (k=1; k<=2; k++) {
+			self=(c[k] >> 1) & 1;
+			n=__builtin_popcount(c[k-1])+__builtin_popcount(c[k])+__builtin_popcount(c[k+1])-self;
+			if ((self ? g->survive : g->birth) & (1 << n)) g->lut[i]|=1 << (k-1);
 		}
 	}
+}
+
+static int64_t nsnow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return((int64_t)ts.tv_sec*NSPERSEC+ts.tv_nsec);
+}
+
+int nextgen(struct game *g, char *frame)
+{
+	int living,x,y,idx,columns=g->columns,rows=g->rows;
+	uint8_t v[COLUMNS+3], out, *up, *mid, *down, *nrow, *t;
+	uint64_t *key;
+
+	living=0;
+	memset(frame,0,FBSIZE);
 
-	// Overwite the old board with the new board
-	for (x=0; x<columns; x++) 
-		for (y=0; y<rows; y++) 
-			board[x][y]=newboard[x][y];
+	for (y=0; y<rows; y++) {
+		down=g->board+((y+rows-1)%rows)*columns;
+		mid=g->board+y*columns;
+		up=g->board+((y+1)%rows)*columns;
+		nrow=g->next+y*columns;
+		key=g->key+y*columns;
 
+		// Column values, with the wrapped-round columns at each end (v[x+1] is column x)
+		for (x=0; x<columns; x++) v[x+1]=down[x] | (mid[x] << 1) | (up[x] << 2);
+		v[0]=v[columns];
+		v[columns+1]=v[1];
+		v[columns+2]=v[2];
+
+		idx=v[0] | (v[1] << 3);
+		for (x=0; x<columns; x+=2) {
+			idx=(idx & 0x3F) | (v[x+2] << 6) | (v[x+3] << 9);
+			out=g->lut[idx];
+			nrow[x]=out & 1;
+			nrow[x+1]=out >> 1;
+			idx>>=6;
+
+			// Fold changed cells into the board hash, live ones into the frame
+			g->hash^=key[x] & -(uint64_t)(nrow[x] ^ mid[x]);
+			g->hash^=key[x+1] & -(uint64_t)(nrow[x+1] ^ mid[x+1]);
+			frame[(y/8)*COLUMNS+x] |= nrow[x] << (y%8);
+			frame[(y/8)*COLUMNS+x+1] |= nrow[x+1] << (y%8);
+			living+=__builtin_popcount(out);
+		}
+	}
+
+	t=g->board; g->board=g->next; g->next=t;
 	return(living);
 }
 
-void life(int pi, int fd, int columns, int rows)
+static void push(const char *frame)
 {
-	int lasttest,living,gens;
+	// Put a frame in the ring, waiting while it is full
+	int64_t t=nsnow();
+
+	pthread_mutex_lock(&ring.lock);
+	while (ring.count == ring.depth)
+		pthread_cond_wait(&ring.notfull,&ring.lock);
+	memcpy(ring.slot[ring.head],frame,FBSIZE);
+	ring.head=(ring.head+1)%ring.depth;
+	++ring.count;
+	pthread_cond_signal(&ring.notempty);
+	pthread_mutex_unlock(&ring.lock);
+
+	stats.simwait+=nsnow()-t;
+}
+
+static void *simulate(void *arg)
+{
+	struct game *g=arg;
+	int living,gens,x,y,i;
 	time_t t;
-	uint8_t x,y;
-	uint8_t board[columns][rows];
+	int64_t t0;
+	char frame[FBSIZE];
 
-	while (1) {
+	gens=0;
+	g->hash=0;
+	g->period=0;
+	memset(frame,0,FBSIZE);
 
-		gens=0;
-		lasttest=0;
-	
-		// Initialize the board with a random pattern - one in twelve pixels on.
-		srand((unsigned) time(&t)); 
-		for (x=0; x<columns; x++) {
-			for (y=0; y<rows; y++) {
-				board[x][y]=rand() < RAND_MAX/12 ? PIXON : PIXOFF;
-				(void) oledsetpixel(pi,fd,x+ORIGIN,y+ORIGIN,board[x][y],FBONLY);
+	// Initialize the board with a random pattern - one in twelve pixels on.
+	srand((unsigned) time(&t)); 
+	for (y=0; y<g->rows; y++) {
+		for (x=0; x<g->columns; x++) {
+			g->board[y*g->columns+x]=rand() < RAND_MAX/12 ? PIXON : PIXOFF;
+			if (g->board[y*g->columns+x] == PIXON) {
+				frame[(y/8)*COLUMNS+x] |= 0x01 << (y%8);
+				g->hash^=g->key[y*g->columns+x];
 			}
 		}
+	}
+	push(frame);
 
-		// Set living cells to 1 (obviously > 1 in all but bizarrely random circumstances
-		living=1;
+	// Set living cells to 1 (obviously > 1 in all but bizarrely random circumstances
+	living=1;
 
-		// Reset genstable and maxliving variables to zero (ignore the starting cell colony count)
-		// and minliving to COLUMNS*ROWS
-		genstable=0;
-		maxliving=0;
-		minliving=COLUMNS*ROWS;
+	// Reset maxliving to zero (ignore the starting cell colony count)
+	// and minliving to COLUMNS*ROWS
+	maxliving=0;
+	minliving=COLUMNS*ROWS;
 
-                // Get the next generation provided some cells are still living or 1000 generations have passed
-		// and the pattern is not stable or repeating (ish - this algortihm is not exact)
+        // Get the next generation provided some cells are still living, GENMAX
+	// generations haven't passed and the board hasn't been seen before
 
-		while ((living > 0) && (gens < GENMAX) && (genstable < STABLEMAX)) {	
+	while ((living > 0) && (gens < GENMAX) && (g->period == 0)) {	
 
-			// Flush the framebuffer and compute the next generation
-			(void) oledflushfb(pi,fd);
-			lasttest=living;
-			living=nextgen(pi,fd,board,columns,rows);
-			++gens;
-
-			// Update the static variables
-			if(living > maxliving) maxliving=living;
-			if(living < minliving) minliving=living;
-			if (living == lasttest) { 
-				++genstable;
+		// Compute the next generation and queue it for display
+		g->history[gens%HISTORY]=g->hash;
+		t0=nsnow();
+		living=nextgen(g,frame);
+		stats.compute+=nsnow()-t0;
+		push(frame);
+		++gens;
+
+		// A still life has period 1, an oscillator its own period
+		for (i=1; (i <= HISTORY) && (i <= gens); i++) {
+			if (g->history[(gens-i)%HISTORY] == g->hash) {
+				g->period=i;
+				break;
 			}
-			else {
-				genstable=0;
+		}
+
+		// Update the static variables
+		if(living > maxliving) maxliving=living;
+		if(living < minliving) minliving=living;
+	}
+
+	stats.gens=gens;
+	stats.living=living;
+
+	pthread_mutex_lock(&ring.lock);
+	ring.eof=1;
+	pthread_cond_signal(&ring.notempty);
+	pthread_mutex_unlock(&ring.lock);
+
+	return(NULL);
+}
+
+void life(int pi, int fd, int columns, int rows, uint16_t birth, uint16_t survive)
+{
+	struct game g;
+	pthread_t st;
+	int64_t t, start;
+	int i;
+
+	g.columns=columns;
+	g.rows=rows;
+	g.birth=birth;
+	g.survive=survive;
+	buildlut(&g);
+	g.board=malloc((size_t)columns*rows);
+	g.next=malloc((size_t)columns*rows);
+	g.key=malloc((size_t)columns*rows*sizeof(uint64_t));
+	if ((g.board == NULL) || (g.next == NULL) || (g.key == NULL)) return;
+	for (i=0; i<columns*rows; i++)
+		g.key[i]=((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+	while (1) {
+
+		memset(&stats,0,sizeof(stats));
+		ring.head=ring.tail=ring.count=ring.eof=0;
+		start=nsnow();
+		pthread_create(&st,NULL,simulate,&g);
+
+		// Display stage - flush generations as the simulation produces them
+		while (1) {
+			t=nsnow();
+			pthread_mutex_lock(&ring.lock);
+			while ((ring.count == 0) && !ring.eof)
+				pthread_cond_wait(&ring.notempty,&ring.lock);
+			if (ring.count == 0) {                  // End of run
+				pthread_mutex_unlock(&ring.lock);
+				break;
 			}
+			memcpy(oledgetfb(),ring.slot[ring.tail],FBSIZE);
+			ring.tail=(ring.tail+1)%ring.depth;
+			--ring.count;
+			pthread_cond_signal(&ring.notfull);
+			pthread_mutex_unlock(&ring.lock);
+			stats.dispwait+=nsnow()-t;
+
+			t=nsnow();
+			(void) oledflushfb(pi,fd);
+			stats.flush+=nsnow()-t;
 		}
+		pthread_join(st,NULL);
+		t=nsnow()-start;
 
-		printf("Last simulation ended after %d generations with %d living cells\n",gens,living);
+		printf("Last simulation ended after %d generations with %d living cells",stats.gens,stats.living);
+		if (g.period == 1) printf(" (still life)");
+		else if (g.period > 1) printf(" (period %d oscillator)",g.period);
+		printf("\n");
 		printf("Maximum living cells was %d, minimum was %d\n",maxliving,minliving);
+		if (stats.gens > 0) {
+			printf("Compute %.0fus/gen, flush %.0fus/gen, %.1f gens/s (ring depth %d)\n",
+			       stats.compute/1e3/stats.gens,stats.flush/1e3/(stats.gens+1),
+			       stats.gens*(double)NSPERSEC/t,ring.depth);
+			printf("Simulation waited %.2fs for ring space, display waited %.2fs for frames\n",
+			       stats.simwait/1e9,stats.dispwait/1e9);
+		}
                 fflush(stdout);
 
 		// Pause for 10 seconds before starting again
 		sleep(10);
 	}
 
+	free(g.board);
+	free(g.next);
+	free(g.key);
 	return;
 }
 
-int main() {
-        int ipi,fdoled,i; 			
+int main(int argc, char *argv[]) {
+        int ipi,fdoled,i=0,opt; 			
+	const char *rule="B3/S23";
+	uint16_t birth, survive;
+
+	while ((opt=getopt(argc,argv,"d:r:")) != -1) {
+		if (opt == 'd') {
+			ring.depth=atoi(optarg);
+		}
+		else if (opt == 'r') {
+			rule=optarg;
+		}
+		else {
+			fprintf(stderr,"Usage: %s [-d ring depth] [-r Bx/Sy]\n",argv[0]);
+			exit(1);
+		}
+	}
+	if (parserule(rule,&birth,&survive) != 0) {
+		fprintf(stderr,"Rule must be of the form Bx/Sy, e.g. B3/S23\n");
+		exit(1);
+	}
+	if ((ring.depth < 1) || (ring.depth > MAXDEPTH)) {
+		fprintf(stderr,"Ring depth must be 1 to %d\n",MAXDEPTH);
+		exit(1);
+	}
+	ring.slot=malloc((size_t)ring.depth*FBSIZE);
+	if (ring.slot == NULL) {
+		fprintf(stderr,"Out of memory for %d frame ring\n",ring.depth);
+		exit(1);
+	}
 
         ipi=pigpio_start(NULL,NULL);	// Initialise connection to pigpiod */ 
         if (ipi < 0) {
@@ -153,7 +376,7 @@ int main() {
 		// Clear the display
 		i=oledclear(ipi,fdoled,FBANDDISPLAY);
 		// Play the game on the full resolution of the display
-		life(ipi,fdoled,COLUMNS,ROWS);
+		life(ipi,fdoled,COLUMNS,ROWS,birth,survive);
 
 	}
 
@@ -161,6 +384,7 @@ int main() {
 
         i2c_close(ipi,fdoled);
         pigpio_stop(ipi);
+	free(ring.slot);
 
 	return(i);
 }
@@ -0,0 +1,368 @@
+/******************************************************************************/
+/*                                                                            */
+/* Asset packer for the                                                       */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Converts images and fonts into one asset pack (see oled1106asset.c) at     */
+/* build time, so nothing is parsed or converted when a program starts:       */
+/*                                                                            */
+/* - PBM (P1 or P4) and XBM images, set bits being lit pixels                 */
+/* - BDF fonts, every glyph placed in the font's bounding box cell. The pack  */
+/*   holds just the code points the font has, however scattered, with a       */
+/*   glyph index of the runs of consecutive ones.                             */
+/*                                                                            */
+/* Each asset is named after its file (without directory or extension)        */
+/* unless given as name=file.                                                 */
+/*                                                                            */
+/* Usage: oled1106pack pack [name=]file ...                                   */
+/*   e.g. oled1106pack assets.pak wifi=icons/wifi.pbm 6x10.bdf                */
+/*                                                                            */
+/* Needs no display or pigpiod, so may run on the build machine.              */
+/*                                                                            */
+/******************************************************************************/
+#include <ctype.h>
+#include <strings.h>
+#include "oled1106.h"
+
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define MAXASSETS       4096    // Most assets in one pack
+#define LINELEN         256     // Longest BDF line
+#define MAXGLYPHS       65535   // Most glyphs in one font
+#define MAXCODE         0x10FFFF        // Highest Unicode code point
+
+struct input {
+	struct oledasset a;             // Index entry (offset filled in when written)
+	uint32_t (*runs)[3];            // A font's glyph index
+	uint8_t *bits;                  // Page-major bitmaps
+	size_t len;
+};
+
+static struct input in[MAXASSETS];
+
+static uint8_t *newbitmap(int w, int h, int count, size_t *len) {
+	// Blank page-major bitmaps for count images of w x h
+	*len = (size_t)w*((h+ROWSPERPAGE-1)/ROWSPERPAGE)*count;
+	return(calloc(*len ? *len : 1, 1));
+}
+
+static void setbit(uint8_t *bits, int w, int x, int y) {
+	// Light pixel (x,y), (0,0) being bottom left
+	bits[(y/ROWSPERPAGE)*w+x] |= 0x01 << (y%ROWSPERPAGE);
+}
+
+static int pbmnumber(FILE *f) {
+	// The next number in a PBM header, skipping white space and comments
+	int c, n = 0;
+
+	while (((c = fgetc(f)) != EOF) && (isspace(c) || (c == '#')))
+		if (c == '#') while (((c = fgetc(f)) != EOF) && (c != '\n'));
+	if ((c == EOF) || !isdigit(c)) return(-1);
+	for (; isdigit(c); c = fgetc(f)) n = n*10+c-'0';
+	return(n);                      // The white space after it has been read
+}
+
+static int readpbm(const char *path, struct input *p) {
+	FILE *f = fopen(path, "rb");
+	int w, h, x, y, c, bin;
+	uint8_t *row;
+
+	if (f == NULL) return(-1);
+	if ((fgetc(f) != 'P') || (((c = fgetc(f)) != '1') && (c != '4'))) {
+		fclose(f);
+		return(-1);
+	}
+	bin = (c == '4');
+	w = pbmnumber(f);
+	h = pbmnumber(f);
+	if ((w < 1) || (h < 1) || (w > 0xFFFF) || (h > 0xFFFF)) {
+		fclose(f);
+		return(-1);
+	}
+
+	p->a.w = w;
+	p->a.h = h;
+	p->bits = newbitmap(w, h, 1, &p->len);
+	row = malloc((w+7)/8);
+	if ((p->bits == NULL) || (row == NULL)) {
+		fclose(f);
+		free(row);
+		return(-1);
+	}
+
+	for (y=h-1; y>=0; y--) {                // Top row first in the file
+		if (bin) {
+			if (fread(row, 1, (w+7)/8, f) != (size_t)(w+7)/8) break;
+			for (x=0; x<w; x++) if (row[x/8] & (0x80 >> (x%8))) setbit(p->bits, w, x, y);
+		}
+		else {
+			for (x=0; x<w; x++) {
+				while (((c = fgetc(f)) != EOF) && isspace(c));
+				if (c == '1') setbit(p->bits, w, x, y);
+				else if (c != '0') break;
+			}
+			if (x < w) break;
+		}
+	}
+
+	free(row);
+	fclose(f);
+	return((y < 0) ? 0 : -1);
+}
+
+static int readxbm(const char *path, struct input *p) {
+	FILE *f = fopen(path, "r");
+	char *text, *s, *e;
+	long n, size;
+	int w = 0, h = 0, x, y, b;
+
+	if (f == NULL) return(-1);
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	text = malloc(size+1);
+	if ((text == NULL) || (fread(text, 1, size, f) != (size_t)size)) {
+		fclose(f);
+		free(text);
+		return(-1);
+	}
+	text[size] = '\0';
+	fclose(f);
+
+	if ((s = strstr(text, "_width")) != NULL) w = strtol(s+6, NULL, 0);
+	if ((s = strstr(text, "_height")) != NULL) h = strtol(s+7, NULL, 0);
+	s = strchr(text, '{');
+	if ((w < 1) || (h < 1) || (w > 0xFFFF) || (h > 0xFFFF) || (s == NULL)) {
+		free(text);
+		return(-1);
+	}
+
+	p->a.w = w;
+	p->a.h = h;
+	p->bits = newbitmap(w, h, 1, &p->len);
+	if (p->bits == NULL) {
+		free(text);
+		return(-1);
+	}
+
+	// Rows top first, (w+7)/8 bytes each, bit 0 the leftmost pixel
+	for (y=h-1, s++; y>=0; y--) {
+		for (x=0; x<w; x+=8) {
+			n = strtol(s, &e, 0);
+			if (e == s) break;
+			for (b=0; (b < 8) && (x+b < w); b++) if (n & (1 << b)) setbit(p->bits, w, x+b, y);
+			s = e+strspn(e, " \t\r\n,");
+		}
+		if (x < w) break;
+	}
+
+	free(text);
+	return((y < 0) ? 0 : -1);
+}
+
+static int bycode(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return((x > y) - (x < y));
+}
+
+static int readbdf(const char *path, struct input *p) {
+	FILE *f = fopen(path, "r");
+	char line[LINELEN];
+	int fw = 0, fh = 0, fx = 0, fy = 0, pass, n = 0, i, k;
+	int enc = -1, bw = 0, bh = 0, bx = 0, by = 0, row = -1, x, cx, cy, nb, d, glyph = -1;
+	uint32_t *codes, *c, code;
+	uint8_t *g;
+
+	if (f == NULL) return(-1);
+	codes = malloc(MAXGLYPHS*sizeof(*codes));
+	if (codes == NULL) {
+		fclose(f);
+		return(-1);
+	}
+
+	// Twice through: find the cell and the code points, then draw the glyphs
+	for (pass=0; pass<2; pass++) {
+		rewind(f);
+		while (fgets(line, sizeof(line), f) != NULL) {
+			if (sscanf(line, "FONTBOUNDINGBOX %d %d %d %d", &fw, &fh, &fx, &fy) == 4) continue;
+			if (sscanf(line, "ENCODING %d", &enc) == 1) {
+				if ((enc < 0) || (enc > MAXCODE)) glyph = -1;   // Not Unicode - skipped
+				else if (pass == 1) {
+					code = enc;
+					c = bsearch(&code, codes, n, sizeof(*codes), bycode);
+					glyph = c-codes;
+				}
+				else if (n++ < MAXGLYPHS) codes[n-1] = enc;
+				continue;
+			}
+			if (pass == 0) continue;
+			if (sscanf(line, "BBX %d %d %d %d", &bw, &bh, &bx, &by) == 4) continue;
+			if (strncmp(line, "BITMAP", 6) == 0) {
+				row = 0;
+				continue;
+			}
+			if (strncmp(line, "ENDCHAR", 7) == 0) {
+				row = -1;
+				glyph = -1;
+				continue;
+			}
+			if ((row < 0) || (row >= bh) || (glyph < 0)) continue;
+
+			// One glyph row, top first, as hex bytes with the leftmost pixel in the top bit
+			g = p->bits+(size_t)glyph*fw*((fh+ROWSPERPAGE-1)/ROWSPERPAGE);
+			nb = (int)(strspn(line, "0123456789abcdefABCDEF")*4);
+			cy = by-fy+bh-1-row;
+			for (x=0; (x < bw) && (x < nb); x++) {
+				d = line[x/4];
+				d = isdigit(d) ? d-'0' : tolower(d)-'a'+10;
+				cx = bx-fx+x;
+				if ((d & (0x08 >> (x%4))) && (cx >= 0) && (cx < fw) && (cy >= 0) && (cy < fh))
+					setbit(g, fw, cx, cy);
+			}
+			row++;
+		}
+
+		if (pass == 0) {
+			if ((fw < 1) || (fh < 1) || (fw > 0xFFFF) || (fh > 0xFFFF) || (n == 0) || (n > MAXGLYPHS)) {
+				fclose(f);
+				free(codes);
+				return(-1);
+			}
+
+			// Code points in order, once each, then the runs of consecutive ones
+			qsort(codes, n, sizeof(*codes), bycode);
+			for (i=1, k=1; i<n; i++) if (codes[i] != codes[k-1]) codes[k++] = codes[i];
+			n = k;
+			p->runs = malloc(n*sizeof(*p->runs));
+			if (p->runs == NULL) {
+				fclose(f);
+				free(codes);
+				return(-1);
+			}
+			for (i=0, k=0; i<n; i++) {
+				if ((k > 0) && (codes[i] == p->runs[k-1][0]+p->runs[k-1][1])) p->runs[k-1][1]++;
+				else {
+					p->runs[k][0] = codes[i];
+					p->runs[k][1] = 1;
+					p->runs[k][2] = i;
+					k++;
+				}
+			}
+
+			p->a.w = fw;
+			p->a.h = fh;
+			p->a.count = n;
+			p->a.runs = k;
+			p->bits = newbitmap(fw, fh, n, &p->len);
+			if (p->bits == NULL) {
+				fclose(f);
+				free(codes);
+				return(-1);
+			}
+		}
+	}
+
+	fclose(f);
+	free(codes);
+	return(0);
+}
+
+static int byname(const void *a, const void *b) {
+	return(strncmp(((const struct input *)a)->a.name, ((const struct input *)b)->a.name, OLEDASSETNAME));
+}
+
+int main(int argc, char *argv[]) {
+	struct oledpackheader hd;
+	const char *path, *base, *ext, *eq;
+	size_t namelen;
+	uint64_t offset;
+	FILE *f;
+	int i, n = 0;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s pack [name=]file.pbm|.xbm|.bdf ...\n", argv[0]);
+		exit(1);
+	}
+	if (argc-2 > MAXASSETS) {
+		fprintf(stderr, "At most %d assets in a pack\n", MAXASSETS);
+		exit(1);
+	}
+
+	for (i=2; i<argc; i++, n++) {
+		memset(&in[n], 0, sizeof(in[n]));
+
+		// Name from name=file, or the file name without directory and extension
+		eq = strchr(argv[i], '=');
+		path = eq ? eq+1 : argv[i];
+		base = strrchr(path, '/') ? strrchr(path, '/')+1 : path;
+		ext = strrchr(base, '.') ? strrchr(base, '.') : base+strlen(base);
+		namelen = eq ? (size_t)(eq-argv[i]) : (size_t)(ext-base);
+		if ((namelen == 0) || (namelen >= OLEDASSETNAME)) {
+			fprintf(stderr, "%s: asset name must be 1 to %d characters\n", argv[i], OLEDASSETNAME-1);
+			exit(1);
+		}
+		memcpy(in[n].a.name, eq ? argv[i] : base, namelen);
+
+		in[n].a.count = 1;
+		if (strcasecmp(ext, ".bdf") == 0) {
+			in[n].a.type = OLEDASSETFONT;
+			if (readbdf(path, &in[n]) != 0) {
+				fprintf(stderr, "%s: not a BDF font\n", path);
+				exit(1);
+			}
+		}
+		else if (strcasecmp(ext, ".xbm") == 0) {
+			if (readxbm(path, &in[n]) != 0) {
+				fprintf(stderr, "%s: not an XBM image\n", path);
+				exit(1);
+			}
+		}
+		else if (readpbm(path, &in[n]) != 0) {
+			fprintf(stderr, "%s: not a PBM image\n", path);
+			exit(1);
+		}
+	}
+
+	// Sort the index so assets can be found by binary search
+	qsort(in, n, sizeof(in[0]), byname);
+	for (i=1; i<n; i++) {
+		if (byname(&in[i-1], &in[i]) == 0) {
+			fprintf(stderr, "Asset %s given twice\n", in[i].a.name);
+			exit(1);
+		}
+	}
+
+	// Each asset's glyph index then bitmaps, from a 4 byte boundary
+	offset = sizeof(hd)+(uint64_t)n*sizeof(struct oledasset);
+	for (i=0; i<n; i++) {
+		in[i].a.offset = offset;
+		offset += (in[i].a.runs*sizeof(*in[i].runs)+in[i].len+3) & ~(uint64_t)3;
+	}
+	if (offset > 0xFFFFFFFFu) {
+		fprintf(stderr, "Pack would be over 4GB\n");
+		exit(1);
+	}
+
+	memcpy(hd.magic, OLEDPACKMAGIC, sizeof(hd.magic));
+	hd.count = n;
+	hd.size = offset;
+
+	f = fopen(argv[1], "wb");
+	if (f == NULL) {
+		perror(argv[1]);
+		exit(1);
+	}
+	fwrite(&hd, sizeof(hd), 1, f);
+	for (i=0; i<n; i++) fwrite(&in[i].a, sizeof(in[i].a), 1, f);
+	for (i=0; i<n; i++) {
+		fwrite(in[i].runs, sizeof(*in[i].runs), in[i].a.runs, f);
+		fwrite(in[i].bits, 1, in[i].len, f);
+		fwrite("\0\0\0", 1, -(in[i].a.runs*sizeof(*in[i].runs)+in[i].len) & 3, f);
+	}
+	if (fclose(f) != 0) {
+		perror(argv[1]);
+		exit(1);
+	}
+
+	printf("%s: %d assets, %lu bytes\n", argv[1], n, (unsigned long)offset);
+	return(0);
+}
@@ -0,0 +1,347 @@
+/******************************************************************************/
+/*                                                                            */
+/* Streaming frame player for the                                             */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/* Tested on a Raspberry Pi 3B+ using the Raspbian Buster operating system.   */
+/*                                                                            */
+/* Plays a stream of raw frames from a file, named pipe or stdin:             */
+/*                                                                            */
+/* - by default each frame is 1024 bytes in the library's page-major layout   */
+/*   (the same as oledgetfb(): page 1 first, bit 0 the lowest row of a page)  */
+/* - with -g each frame is 8 bit grayscale, top row first, 128x64 unless -s   */
+/*   gives another size. It is scaled to fit and converted with oleddither()  */
+/*   using method -m (0 threshold, 1 Bayer, 2 Floyd-Steinberg, 3 Atkinson)    */
+/*   and level -t (default 128).                                              */
+/*                                                                            */
+/* A reader thread prefetches frames into a bounded ring (-d slots) while     */
+/* the main thread presents them at -f frames per second. Frames that are a   */
+/* whole frame period late are dropped so playback keeps to time when the     */
+/* bus can't keep up. Regular files are mmapped rather than read.             */
+/*                                                                            */
+/* Usage: oled1106play [-f fps] [-d depth] [-g] [-s WxH] [-m method]          */
+/*                    [-t level] [file]                                       */
+/*   e.g. ffmpeg -i clip.mp4 -vf scale=160:120 -f rawvideo -pix_fmt gray - |  */
+/*        oled1106play -s 160x120 -m 1 -f 25                                  */
+/*                                                                            */
+/* Prerequisite: PIGPIOD must be installed and running.                       */
+/*                                                                            */
+/******************************************************************************/
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define FBSIZE          1024    // Bytes in a page-major frame
+#define MAXDEPTH        256     // Largest ring the user can ask for
+#define NSPERSEC        1000000000L
+#define WAKEPERIOD      100000000L      // Longest wait for a frame before checking for Ctrl-C
+
+/* The prefetch ring. The reader fills slots at head, the presenter empties   */
+/* them at tail; count is the number of full slots.                           */
+
+static struct {
+	char (*slot)[FBSIZE];
+	int depth, head, tail, count;
+	int eof;
+	pthread_mutex_t lock;
+	pthread_cond_t notfull, notempty;
+} ring = { NULL, 0, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static struct {
+	int fd;                 // Input descriptor (when not mmapped)
+	const uint8_t *map;     // Mapped input file, or NULL
+	size_t maplen;
+	int gray;               // Input is 8 bit grayscale
+	int width, height;      // Size of a grayscale frame
+	uint8_t method;         // oleddither() conversion method
+	uint8_t level;          // Grey level at which pixels turn on
+} src;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig) {
+	running = 0;
+}
+
+static int64_t nsnow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return((int64_t)ts.tv_sec*NSPERSEC+ts.tv_nsec);
+}
+
+static void nsabs(int64_t t, struct timespec *ts) {
+	ts->tv_sec=t/NSPERSEC;
+	ts->tv_nsec=t%NSPERSEC;
+}
+
+static int readframe(uint8_t *buf, size_t len, size_t *offset) {
+/******************************************************************************/
+/*                                                                            */
+/* Fetch the next len bytes of input into buf. Returns 1 for a whole frame,   */
+/* 0 at end of input (a trailing partial frame is discarded).                 */
+/*                                                                            */
+/******************************************************************************/
+	size_t got;
+	ssize_t n;
+
+	if (src.map != NULL) {
+		if (*offset+len > src.maplen) return(0);
+		memcpy(buf,src.map+*offset,len);
+		*offset+=len;
+		return(1);
+	}
+
+	for (got=0; got<len; got+=n) {
+		n=read(src.fd,buf+got,len-got);
+		if ((n < 0) && (errno == EINTR) && running) { n=0; continue; }
+		if (n <= 0) return(0);
+	}
+	return(1);
+}
+
+static void *reader(void *arg) {
+/******************************************************************************/
+/*                                                                            */
+/* Prefetch stage - read and convert frames into the ring until end of input. */
+/* Blocks while the ring is full, so memory use is bounded by the depth.      */
+/*                                                                            */
+/******************************************************************************/
+	uint8_t *in;
+	char frame[FBSIZE];
+	size_t offset=0, len;
+
+	len=src.gray ? (size_t)src.width*src.height : FBSIZE;
+	in=malloc(len);
+
+	while (running && (in != NULL) && readframe(in,len,&offset)) {
+		if (src.gray) oleddither(in,src.width,src.height,src.width,src.method,src.level,frame);
+		else memcpy(frame,in,FBSIZE);
+
+		pthread_mutex_lock(&ring.lock);
+		while (running && (ring.count == ring.depth))
+			pthread_cond_wait(&ring.notfull,&ring.lock);
+		if (!running) {
+			pthread_mutex_unlock(&ring.lock);
+			break;
+		}
+		memcpy(ring.slot[ring.head],frame,FBSIZE);
+		ring.head=(ring.head+1)%ring.depth;
+		++ring.count;
+		pthread_cond_signal(&ring.notempty);
+		pthread_mutex_unlock(&ring.lock);
+	}
+
+	free(in);
+	pthread_mutex_lock(&ring.lock);
+	ring.eof=1;
+	pthread_cond_signal(&ring.notempty);
+	pthread_mutex_unlock(&ring.lock);
+
+	return(NULL);
+}
+
+static int play(int pi, int fd, int fps) {
+/******************************************************************************/
+/*                                                                            */
+/* Present stage. Frame n of the stream is due at start+n*period. A frame     */
+/* that comes out of the ring a whole period or more after it was due is      */
+/* dropped; otherwise we sleep to its deadline and flush it. If the ring runs */
+/* dry (a slow producer) the timeline restarts from the next frame so a burst */
+/* of input afterwards isn't dropped as late.                                 */
+/*                                                                            */
+/******************************************************************************/
+	int i=0, underrun;
+	long shown=0, dropped=0, underruns=0, lastshown=0, lastdropped=0;
+	int64_t period, start, due, now, first, report;
+	struct timespec ts;
+
+	period=NSPERSEC/fps;
+	start=nsnow();
+	first=start;
+	report=start+5*NSPERSEC;
+	due=start;
+
+	while (running) {
+		underrun=0;
+		pthread_mutex_lock(&ring.lock);
+		while (running && (ring.count == 0) && !ring.eof) {
+			underrun=1;
+			// stop() can't signal the condition from a signal handler, so
+			// wake up now and again to see whether we've been interrupted
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_nsec+=WAKEPERIOD;
+			if (ts.tv_nsec >= NSPERSEC) {
+				ts.tv_nsec-=NSPERSEC;
+				++ts.tv_sec;
+			}
+			pthread_cond_timedwait(&ring.notempty,&ring.lock,&ts);
+		}
+		if (!running || (ring.count == 0)) {    // Interrupted, or end of stream
+			pthread_mutex_unlock(&ring.lock);
+			break;
+		}
+		memcpy(oledgetfb(),ring.slot[ring.tail],FBSIZE);
+		ring.tail=(ring.tail+1)%ring.depth;
+		--ring.count;
+		pthread_cond_signal(&ring.notfull);
+		pthread_mutex_unlock(&ring.lock);
+
+		now=nsnow();
+		if (underrun) {
+			++underruns;
+			due=now;
+		}
+
+		if (now >= due+period) {
+			++dropped;
+		}
+		else {
+			nsabs(due,&ts);
+			while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR)
+				if (!running) break;
+			i=oledflushfb(pi,fd);
+			if (i != 0) break;
+			++shown;
+		}
+		due+=period;
+
+		now=nsnow();
+		if (now >= report) {
+			fprintf(stderr,"%.1f fps, %ld dropped in the last 5s\n",
+			        (shown-lastshown)*(double)NSPERSEC/(now-report+5*NSPERSEC),
+			        dropped-lastdropped);
+			lastshown=shown;
+			lastdropped=dropped;
+			report=now+5*NSPERSEC;
+		}
+	}
+
+	now=nsnow();
+	printf("Played %ld frames, dropped %ld, %ld underruns, in %.2fs\n",
+	       shown,dropped,underruns,(double)(now-first)/NSPERSEC);
+	printf("Sustained %.1f fps (target %d fps)\n",
+	       now > first ? shown*(double)NSPERSEC/(now-first) : 0.0,fps);
+
+	return(i);
+}
+
+int main(int argc, char *argv[]) {
+        int ipi,fdoled,i,opt,fps=30,detached=0;
+	const char *path=NULL;
+	struct stat st;
+	pthread_t rt;
+
+	ring.depth=8;
+	src.fd=STDIN_FILENO;
+	src.width=COLUMNS;
+	src.height=ROWS;
+	src.method=OLEDTHRESHOLD;
+	src.level=128;
+
+	while ((opt=getopt(argc,argv,"f:d:gs:m:t:")) != -1) {
+		switch (opt) {
+		case 'f': fps=atoi(optarg); break;
+		case 'd': ring.depth=atoi(optarg); break;
+		case 'g': src.gray=1; break;
+		case 's':
+			src.gray=1;
+			if (sscanf(optarg,"%dx%d",&src.width,&src.height) != 2) src.width=0;
+			break;
+		case 'm': src.gray=1; src.method=(uint8_t)atoi(optarg); break;
+		case 't': src.level=(uint8_t)atoi(optarg); break;
+		default:
+			fprintf(stderr,"Usage: %s [-f fps] [-d depth] [-g] [-s WxH] [-m method] [-t level] [file]\n",argv[0]);
+			exit(1);
+		}
+	}
+	if (optind < argc) path=argv[optind];
+
+	if ((fps < 1) || (ring.depth < 1) || (ring.depth > MAXDEPTH)) {
+		fprintf(stderr,"fps must be at least 1 and depth 1 to %d\n",MAXDEPTH);
+		exit(1);
+	}
+	if ((src.width < 1) || (src.width > 65535) || (src.height < 1) || (src.method > OLEDATKINSON)) {
+		fprintf(stderr,"Invalid grayscale frame size or conversion method\n");
+		exit(1);
+	}
+
+	/* Open the input - regular files are mapped, anything else is read */
+
+	if ((path != NULL) && (strcmp(path,"-") != 0)) {
+		src.fd=open(path,O_RDONLY);
+		if (src.fd < 0) {
+			perror(path);
+			exit(1);
+		}
+	}
+	if ((fstat(src.fd,&st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+		src.map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,src.fd,0);
+		if (src.map == MAP_FAILED) {
+			src.map=NULL;
+		}
+		else {
+			src.maplen=st.st_size;
+			madvise((void *)src.map,src.maplen,MADV_SEQUENTIAL);
+			madvise((void *)src.map,src.maplen,MADV_WILLNEED);
+		}
+	}
+
+	ring.slot=malloc((size_t)ring.depth*FBSIZE);
+	if (ring.slot == NULL) {
+		fprintf(stderr,"Out of memory for %d frame ring\n",ring.depth);
+		exit(1);
+	}
+
+        ipi=pigpio_start(NULL,NULL);	// Initialise connection to pigpiod */
+        if (ipi < 0) {
+		fprintf(stderr,"Failed to connect to pigpiod - error %d\n",ipi);
+                exit(1);
+        }
+
+        fdoled=i2c_open(ipi,1,SH1106ADDR,0); // Get handle to 128x64 OLED display
+        if (fdoled < 0) {
+		fprintf(stderr,"Failed to initialize OLED - error %d\n",fdoled);
+                exit(1);
+        }
+
+	signal(SIGINT,stop);
+	signal(SIGTERM,stop);
+
+	i=oledinit(ipi,fdoled);
+	if (i == 0) i=oledclear(ipi,fdoled,FBANDDISPLAY);
+	if (i == 0) {
+		pthread_create(&rt,NULL,reader,NULL);
+		i=play(ipi,fdoled,fps);
+
+		// Stop the reader. Reading a mapped file never blocks, so that reader
+		// always finishes and is waited for. One blocked on a pipe that never
+		// delivers again is left to die with the process - along with the ring
+		// and input it may still be using.
+		pthread_mutex_lock(&ring.lock);
+		running=0;
+		pthread_cond_signal(&ring.notfull);
+		detached=!ring.eof && (src.map == NULL);
+		pthread_mutex_unlock(&ring.lock);
+		if (detached) pthread_detach(rt);
+		else pthread_join(rt,NULL);
+	}
+
+        /* Clean up and exit */
+
+	if (!detached) {
+		if (src.map != NULL) munmap((void *)src.map,src.maplen);
+		free(ring.slot);
+	}
+        i2c_close(ipi,fdoled);
+        pigpio_stop(ipi);
+
+	return(i);
+}
@@ -0,0 +1,88 @@
+/******************************************************************************/
+/*                                                                            */
+/* Display server for the                                                     */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/* Tested on a Raspberry Pi 3B+ using the Raspbian Buster operating system.   */
+/*                                                                            */
+/* Owns the OLED and publishes its framebuffer as POSIX shared memory so that */
+/* several processes can draw on the one display. A client does:              */
+/*                                                                            */
+/*      shm=oledshmattach(NULL);                                              */
+/*      oledstr(0,0,"Hello",8,0,FBONLY);        // pi and fd are not used     */
+/*      oledshmdamage(shm,0x80);                // page 8 changed             */
+/*                                                                            */
+/* and the server flushes the damaged pages.                                  */
+/*                                                                            */
+/* Usage: oled1106server [shared memory name]                                 */
+/*                                                                            */
+/* Prerequisite: PIGPIOD must be installed and running.                       */
+/*                                                                            */
+/******************************************************************************/
+#include <signal.h>
+#include <sys/mman.h>
+#include "oled1106.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig) {
+	running = 0;
+}
+
+int main(int argc, char *argv[]) {
+        int ipi,fdoled,i;
+	uint8_t mask;
+	const char *name;
+	struct oledshm *shm;
+
+	name = (argc > 1) ? argv[1] : OLEDSHMNAME;
+
+        ipi=pigpio_start(NULL,NULL);	// Initialise connection to pigpiod */
+        if (ipi < 0) {
+		fprintf(stderr,"Failed to connect to pigpiod - error %d\n",ipi);
+                exit(1);
+        }
+
+        fdoled=i2c_open(ipi,1,SH1106ADDR,0); // Get handle to 128x64 OLED display
+        if (fdoled < 0) {
+		fprintf(stderr,"Failed to initialize OLED - error %d\n",fdoled);
+                exit(1);
+        }
+
+	i=oledinit(ipi,fdoled);
+	if (i == 0) i=oledclear(ipi,fdoled,FBANDDISPLAY);
+
+	shm=oledshmcreate(name);
+	if (shm == NULL) {
+		perror("Failed to create shared framebuffer");
+		i=1;
+	}
+
+	signal(SIGINT,stop);
+	signal(SIGTERM,stop);
+
+	// Flush pages as clients damage them. The timeout just lets us notice
+	// a signal promptly; posts made while a flush is in progress are merged
+	// and picked up on the next pass round the loop.
+
+	oledsetfb(shm != NULL ? (char *)shm->fb : NULL);
+
+	while (running && (i == 0)) {
+		mask=oledshmwait(shm,250);
+		if (mask == 0) continue;
+		i=oledflushpages(ipi,fdoled,mask);
+		__atomic_add_fetch(&shm->flushes,1,__ATOMIC_RELEASE);
+	}
+
+	if (i != 0) fprintf(stderr,"Display server stopped - error %d\n",i);
+
+        /* Clean up and exit */
+
+	if (shm != NULL) {
+		oledshmdetach(shm);
+		shm_unlink(name);
+	}
+        i2c_close(ipi,fdoled);
+        pigpio_stop(ipi);
+
+	return(i);
+}
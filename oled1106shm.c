@@ -0,0 +1,153 @@
+/******************************************************************************/
+/*                                                                            */
+/* Shared memory framebuffer support for the                                  */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A display server (see oled1106server.c) owns the I2C device and creates a  */
+/* POSIX shared memory segment holding the framebuffer. Client processes map  */
+/* the same segment, point the library at it with oledsetfb() and draw with   */
+/* the normal functions in framebuffer only mode. They then post the pages    */
+/* they changed; the server is woken through a futex in the segment and       */
+/* flushes just those pages. No pixel data is copied between processes.       */
+/*                                                                            */
+/******************************************************************************/
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "oled1106.h"
+
+static struct oledshm *oledshmmap(const char *name, int oflag) {
+/******************************************************************************/
+/*                                                                            */
+/* Open (and optionally create) the named segment and map it read/write.      */
+/*                                                                            */
+/******************************************************************************/
+	int fd;
+	void *p;
+
+	if (name == NULL) name = OLEDSHMNAME;
+
+	fd = shm_open(name, oflag, 0666);
+	if (fd < 0) return(NULL);
+
+	if ((oflag & O_CREAT) && (ftruncate(fd, sizeof(struct oledshm)) != 0)) {
+		close(fd);
+		return(NULL);
+	}
+
+	p = mmap(NULL, sizeof(struct oledshm), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);                      // The mapping keeps the segment alive
+	if (p == MAP_FAILED) return(NULL);
+
+	return((struct oledshm *)p);
+}
+
+struct oledshm *oledshmcreate(const char *name) {
+/******************************************************************************/
+/*                                                                            */
+/* Server side - create (or reuse) the shared framebuffer segment, clear it   */
+/* and mark it ready for clients. Returns NULL with errno set on failure.     */
+/*                                                                            */
+/******************************************************************************/
+	struct oledshm *shm;
+
+	shm = oledshmmap(name, O_RDWR|O_CREAT);
+	if (shm == NULL) return(NULL);
+
+	memset(shm->fb, 0, sizeof(shm->fb));
+	shm->damage = 0;
+	shm->pagemask = 0;
+	shm->flushes = 0;
+	__atomic_store_n(&shm->magic, OLEDSHMMAGIC, __ATOMIC_RELEASE);
+
+	return(shm);
+}
+
+struct oledshm *oledshmattach(const char *name) {
+/******************************************************************************/
+/*                                                                            */
+/* Client side - map the server's segment and make it the library's           */
+/* framebuffer, so oledsetpixel(), oledstr() etc. with FBONLY draw straight   */
+/* into shared memory. Returns NULL (errno ENODEV if the server has not yet   */
+/* initialised the segment) on failure.                                       */
+/*                                                                            */
+/******************************************************************************/
+	struct oledshm *shm;
+
+	shm = oledshmmap(name, O_RDWR);
+	if (shm == NULL) return(NULL);
+
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != OLEDSHMMAGIC) {
+		munmap(shm, sizeof(struct oledshm));
+		errno = ENODEV;
+		return(NULL);
+	}
+
+	oledsetfb((char *)shm->fb);
+	return(shm);
+}
+
+int oledshmdetach(struct oledshm *shm) {
+/******************************************************************************/
+/*                                                                            */
+/* Unmap the segment. If it is the library's current framebuffer the          */
+/* library reverts to its own private framebuffer.                            */
+/*                                                                            */
+/******************************************************************************/
+
+	if (shm == NULL) return(-1);
+	if (oledgetfb() == (char *)shm->fb) oledsetfb(NULL);
+
+	return(munmap(shm, sizeof(struct oledshm)));
+}
+
+int oledshmdamage(struct oledshm *shm, uint8_t pagemask) {
+/******************************************************************************/
+/*                                                                            */
+/* Client side - tell the server that the pages in pagemask (bit 0 = page 1)  */
+/* have changed. The mask is merged with any damage not yet flushed, so a     */
+/* busy server coalesces several posts into one flush.                        */
+/*                                                                            */
+/******************************************************************************/
+
+	if ((shm == NULL) || (pagemask == 0)) return(0);
+
+	__atomic_fetch_or(&shm->pagemask, pagemask, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&shm->damage, 1, __ATOMIC_RELEASE);
+
+	// Wake the server (a no-op in the kernel if it is busy flushing)
+	return(syscall(SYS_futex, &shm->damage, FUTEX_WAKE, 1, NULL, NULL, 0) < 0 ? -1 : 0);
+}
+
+uint8_t oledshmwait(struct oledshm *shm, int timeoutms) {
+/******************************************************************************/
+/*                                                                            */
+/* Server side - sleep until a client posts damage or timeoutms passes (a     */
+/* negative timeout waits for ever). Returns the pages to flush and clears    */
+/* them, or 0 if the wait timed out or was interrupted by a signal.           */
+/*                                                                            */
+/******************************************************************************/
+	uint32_t seq, mask;
+	struct timespec ts, *tsp = NULL;
+
+	if (timeoutms >= 0) {
+		ts.tv_sec = timeoutms/1000;
+		ts.tv_nsec = (timeoutms%1000)*1000000L;
+		tsp = &ts;
+	}
+
+	// Read the sequence number before checking the mask - a post that
+	// lands in between changes the futex word and the wait returns at once.
+
+	seq = __atomic_load_n(&shm->damage, __ATOMIC_ACQUIRE);
+	mask = __atomic_exchange_n(&shm->pagemask, 0, __ATOMIC_ACQ_REL);
+	if (mask != 0) return((uint8_t)mask);
+
+	syscall(SYS_futex, &shm->damage, FUTEX_WAIT, seq, tsp, NULL, 0);
+
+	return((uint8_t)__atomic_exchange_n(&shm->pagemask, 0, __ATOMIC_ACQ_REL));
+}
@@ -0,0 +1,143 @@
+/******************************************************************************/
+/*                                                                            */
+/* 4-wire SPI transport for the                                               */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* SPI versions of the modules clock at 8MHz or more, against 400kHz for I2C, */
+/* and have no control bytes: a D/C line (a GPIO here) says whether a byte is */
+/* a command (low) or display data (high). oledspiwrite() is a transport for  */
+/* oledsettransport() that takes the library's I2C-framed writes, strips the  */
+/* control bytes and sends each run of commands or data as one spi_write()    */
+/* from a contiguous buffer, so all the drawing and flushing code works       */
+/* unchanged. A page update is two transfers - the three addressing commands  */
+/* and then up to 128 bytes of data; the SH1106 has no horizontal addressing  */
+/* mode, so a frame can't be one transfer. D/C is only written when it has to */
+/* change.                                                                    */
+/*                                                                            */
+/*      h=oledspiopen(pi,&spi,0,8000000,24,25);  // CE0, 8MHz, D/C 24, RES 25 */
+/*      oledinit(pi,h);                                                       */
+/*                                                                            */
+/* spiwrite and dcwrite default to pigpiod's spi_write() and gpio_write().    */
+/* Set them in a zeroed struct and call oledsettransport(oledspiwrite,&spi)   */
+/* to drive a fake SPI device instead (no oledspiopen() needed).              */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define SPIRUN          256     // Bytes gathered before a transfer is forced
+
+int oledspiopen(int pi, struct oledspi *s, unsigned chan, unsigned baud, int dcgpio, int resetgpio) {
+/******************************************************************************/
+/*                                                                            */
+/* Open SPI channel chan (0 = CE0, 1 = CE1) at baud bits/s through pigpiod,   */
+/* make dcgpio the D/C line, pulse resetgpio low to reset the module (-1 if   */
+/* RES isn't wired to a GPIO) and route all display writes over it. Returns   */
+/* the SPI handle, which is passed to oledinit() and the drawing functions in */
+/* place of the I2C handle, or a pigpiod error (NOTRANSPORT if the library    */
+/* was built with -DOLEDNOPIGPIO).                                            */
+/*                                                                            */
+/******************************************************************************/
+#ifdef OLEDNOPIGPIO
+	return(olederror(NOTRANSPORT));
+#else
+	int h, i;
+
+	memset(s, 0, sizeof(*s));
+	s->spiwrite = spi_write;
+	s->dcwrite = gpio_write;
+	s->dc = dcgpio;
+
+	i = set_mode(pi, dcgpio, PI_OUTPUT);
+	if (i != 0) return(i);
+
+	if (resetgpio >= 0) {
+		i = set_mode(pi, resetgpio, PI_OUTPUT);
+		if (i == 0) i = gpio_write(pi, resetgpio, 0);
+		usleep(10);                     // RES low for at least 10us ...
+		if (i == 0) i = gpio_write(pi, resetgpio, 1);
+		usleep(10);                     // ... and the same again before commands
+		if (i != 0) return(i);
+	}
+
+	h = spi_open(pi, chan, baud, 0);        // Mode 0, CE active low
+	if (h < 0) return(h);
+
+	oledsettransport(oledspiwrite, s);
+	return(h);
+#endif
+}
+
+static int oledspisend(struct oledspi *s, int pi, int fd, int dc, char *run, unsigned n) {
+	// One transfer: set D/C if it isn't already right, then send the run
+	int i;
+
+	if (n == 0) return(0);
+	if (!s->dcset || (dc != s->level)) {
+		i = s->dcwrite(pi, s->dc, dc);
+		if (i != 0) return(i);
+		s->dcset = 1;
+		s->level = dc;
+	}
+
+	i = s->spiwrite(pi, fd, run, n);        // Returns the bytes sent
+	if (i < 0) return(i);
+	s->transfers++;
+	s->bytes += n;
+
+	return(0);
+}
+
+int oledspiwrite(void *ctx, int pi, int fd, char *buf, unsigned len) {
+/******************************************************************************/
+/*                                                                            */
+/* Transport for oledsettransport(), ctx being a struct oledspi and fd the    */
+/* SPI handle. The I2C control bytes in buf are decoded (Co=1: one byte       */
+/* follows, then another control byte; Co=0: the rest of the write) and       */
+/* bytes of the same kind gathered into runs, each sent with D/C set from     */
+/* the control byte's D/C bit. Returns 0 or the pigpiod error.                */
+/*                                                                            */
+/******************************************************************************/
+	struct oledspi *s = ctx;
+	char run[SPIRUN];
+	unsigned i = 0, n = 0, k, count;
+	int i2, dc, rundc = -1;
+	uint8_t ctl;
+
+	while (i < len) {
+		ctl = buf[i++];
+		if (i == len) break;
+		dc = (ctl & 0x40) != 0;
+		count = (ctl & 0x80) ? 1 : len-i;
+
+		if ((dc != rundc) || (n+count > SPIRUN)) {
+			i2 = oledspisend(s, pi, fd, rundc, run, n);
+			if (i2 != 0) return(i2);
+			n = 0;
+			rundc = dc;
+		}
+
+		// The rest of the write is already contiguous - send it from buf
+		if ((n == 0) && (count == len-i)) return(oledspisend(s, pi, fd, dc, buf+i, count));
+
+		for (k=0; k<count; k++) run[n++] = buf[i++];
+	}
+
+	return(oledspisend(s, pi, fd, rundc, run, n));
+}
+
+int oledspiclose(int pi, int fd, struct oledspi *s) {
+/******************************************************************************/
+/*                                                                            */
+/* Close the SPI handle returned by oledspiopen() and put display writes back */
+/* on pigpiod's I2C functions.                                                */
+/*                                                                            */
+/******************************************************************************/
+
+	oledsettransport(NULL, NULL);
+	s->dcset = 0;
+#ifdef OLEDNOPIGPIO
+	return(0);
+#else
+	return(spi_close(pi, fd));
+#endif
+}
@@ -0,0 +1,128 @@
+/******************************************************************************/
+/*                                                                            */
+/* SPI transport test for the                                                 */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Drives oledspiwrite() with a fake spidev: spiwrite and dcwrite hooks that  */
+/* record the D/C line and replay each transfer into an SH1106 emulator as a  */
+/* command or data stream. The same drawing is sent to a second emulator      */
+/* over the normal I2C framing, and the test checks that:                     */
+/*                                                                            */
+/* - the SPI emulator's display RAM matches the framebuffer,                  */
+/* - both emulators end in the same state, and                                */
+/* - no transfer mixes commands and data, and D/C is only written when it     */
+/*   changes.                                                                 */
+/*                                                                            */
+/* 'make test' builds it with -DOLEDNOPIGPIO and runs it. Exits non-zero on   */
+/* any mismatch.                                                              */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define SPIHANDLE       7       // Handle the fake device expects
+#define MAXTRANSFER     1024
+
+static struct {
+	struct oledemu emu;     // The panel on the far side of the SPI bus
+	int level;              // D/C line, -1 until first written
+	long dcwrites, samelevel, badhandle, toolong;
+} dev;
+
+static int fakedc(int pi, unsigned gpio, unsigned level) {
+	if ((int)level == dev.level) ++dev.samelevel;
+	dev.level = level;
+	++dev.dcwrites;
+	return(0);
+}
+
+static int fakespi(int pi, unsigned h, char *buf, unsigned n) {
+	// Replay a transfer into the emulator as an I2C command or data stream
+	char frame[1+MAXTRANSFER];
+
+	if (h != SPIHANDLE) ++dev.badhandle;
+	if ((n > MAXTRANSFER) || (dev.level < 0)) {
+		++dev.toolong;
+		return(0);
+	}
+	frame[0] = dev.level ? 0x40 : 0x00;
+	memcpy(frame+1, buf, n);
+	if (oledemuwrite(&dev.emu, pi, h, frame, n+1) != 0) return(-1);
+	return(n);                      // spi_write() returns the bytes sent
+}
+
+static int scene(int fd) {
+	// The drawing sent over both transports
+	static const int tri[] = {70,4, 124,10, 96,60};
+	int i = 0;
+
+	i |= oledinit(0,fd);
+	i |= oledstr(0,fd,"SPI transport",8,0,FBANDDISPLAY);
+	i |= oledfillcircle(0,fd,30,28,20,PIXON,FBANDDISPLAY);
+	i |= oledfillpoly(0,fd,tri,3,PIXINV,FBANDDISPLAY);
+	i |= oledsetpixel(0,fd,128,1,PIXON,FBANDDISPLAY);
+	i |= oledstartline(0,fd,0);
+	i |= oledrotate(0,fd,OLEDROT180,0);
+	i |= oledrotate(0,fd,OLEDROT0,0);
+	i |= oledflushfb(0,fd);
+	return(i);
+}
+
+int main(void) {
+	static struct oledemu i2c;
+	struct oledspi spi;
+	char shown[COLUMNS*ROWS/8];
+	int failures = 0;
+
+	// Reference: the same drawing over I2C framing
+	oledemuinit(&i2c, 400000);
+	oledsettransport(oledemuwrite, &i2c);
+	if (scene(0) != 0) ++failures;
+
+	// A zeroed struct with the hooks set needs no oledspiopen()
+	memset(&spi, 0, sizeof(spi));
+	spi.spiwrite = fakespi;
+	spi.dcwrite = fakedc;
+	spi.dc = 24;
+	oledemuinit(&dev.emu, 400000);
+	dev.level = -1;
+	oledsettransport(oledspiwrite, &spi);
+	if (scene(SPIHANDLE) != 0) {
+		printf("FAIL drawing over SPI returned an error\n");
+		++failures;
+	}
+	oledsettransport(NULL, NULL);
+
+	oledemuframe(&dev.emu, shown);
+	if (memcmp(shown, oledgetfb(), sizeof(shown)) != 0) {
+		printf("FAIL SPI display differs from framebuffer\n");
+		++failures;
+	}
+	if ((memcmp(dev.emu.gram, i2c.gram, sizeof(i2c.gram)) != 0) ||
+	    (dev.emu.startline != i2c.startline) || (dev.emu.segremap != i2c.segremap) ||
+	    (dev.emu.comscan != i2c.comscan) || (dev.emu.on != i2c.on) ||
+	    (dev.emu.commands != i2c.commands) || (dev.emu.data != i2c.data)) {
+		printf("FAIL SPI and I2C emulators differ (%ld/%ld commands, %ld/%ld data bytes)\n",
+		       dev.emu.commands, i2c.commands, dev.emu.data, i2c.data);
+		++failures;
+	}
+	if ((dev.emu.unknown != 0) || (dev.emu.overrun != 0)) {
+		printf("FAIL %ld unknown commands, %ld writes past column 131\n", dev.emu.unknown, dev.emu.overrun);
+		++failures;
+	}
+	if (dev.samelevel || dev.badhandle || dev.toolong) {
+		printf("FAIL %ld needless D/C writes, %ld wrong handles, %ld bad transfers\n",
+		       dev.samelevel, dev.badhandle, dev.toolong);
+		++failures;
+	}
+	if ((spi.transfers != dev.emu.writes) || (spi.bytes != dev.emu.commands+dev.emu.data)) {
+		printf("FAIL transport counted %ld transfers of %ld bytes, device saw %ld of %ld\n",
+		       spi.transfers, spi.bytes, dev.emu.writes, dev.emu.commands+dev.emu.data);
+		++failures;
+	}
+
+	printf("%ld SPI transfers, %ld bytes, %ld D/C changes\n", spi.transfers, spi.bytes, dev.dcwrites);
+	printf("%s\n", failures ? "SPI transport test FAILED" : "SPI transport test passed");
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,310 @@
+/******************************************************************************/
+/*                                                                            */
+/* Sprite layer for the                                                       */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Sprites are small bitmaps (optionally with masks and several animation     */
+/* frames) moved over a static background. The background is captured once    */
+/* from the framebuffer; on each tick only the areas under sprites that have  */
+/* moved, changed frame or appeared/disappeared are restored, the sprites     */
+/* touching those areas are redrawn in z order, and just those rectangles are */
+/* flushed. The cost of a tick therefore follows sprite area, not the screen. */
+/*                                                                            */
+/******************************************************************************/
+#include <time.h>
+#include <errno.h>
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define PAGES           8       // The top line of the diplay is on page 8.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+#define NSPERSEC        1000000000L
+
+static int overlaps(const struct oledrect *a, const struct oledrect *b) {
+	return((a->x < b->x+b->w) && (b->x < a->x+a->w) &&
+	       (a->y < b->y+b->h) && (b->y < a->y+a->h));
+}
+
+static int contains(const struct oledrect *a, const struct oledrect *b) {
+	return((b->x >= a->x) && (b->y >= a->y) &&
+	       (b->x+b->w <= a->x+a->w) && (b->y+b->h <= a->y+a->h));
+}
+
+static int clipbounds(const struct oledsprite *s, struct oledrect *b) {
+	// The part of a sprite on the display; returns 0 if none of it is
+	int x1 = s->x+s->w, y1 = s->y+s->h;
+
+	b->x = (s->x < ORIGIN) ? ORIGIN : s->x;
+	b->y = (s->y < ORIGIN) ? ORIGIN : s->y;
+	b->w = ((x1 > COLUMNS+ORIGIN) ? COLUMNS+ORIGIN : x1)-b->x;
+	b->h = ((y1 > ROWS+ORIGIN) ? ROWS+ORIGIN : y1)-b->y;
+	return((b->w > 0) && (b->h > 0));
+}
+
+static void addrect(struct oledspritelayer *layer, int x, int y, int w, int h) {
+/******************************************************************************/
+/*                                                                            */
+/* Add a rectangle to the layer's damage list, clipped to the display and     */
+/* merged with any rectangle it overlaps. If the list is full the new area is */
+/* merged into the last entry, which is always correct, just less tight.      */
+/*                                                                            */
+/******************************************************************************/
+	struct oledrect r, *d;
+	int i, x1, y1, merged;
+
+	// Clip to the display
+	x1 = x+w; y1 = y+h;
+	if (x < ORIGIN) x = ORIGIN;
+	if (y < ORIGIN) y = ORIGIN;
+	if (x1 > COLUMNS+ORIGIN) x1 = COLUMNS+ORIGIN;
+	if (y1 > ROWS+ORIGIN) y1 = ROWS+ORIGIN;
+	if ((x >= x1) || (y >= y1)) return;
+	r.x = x; r.y = y; r.w = x1-x; r.h = y1-y;
+
+	// Grow r by absorbing everything it overlaps, until nothing does
+	do {
+		merged = 0;
+		for (i=0; i<layer->ndirty; i++) {
+			d = &layer->dirty[i];
+			if (!overlaps(&r, d)) continue;
+			x = (d->x < r.x) ? d->x : r.x;
+			y = (d->y < r.y) ? d->y : r.y;
+			x1 = (d->x+d->w > r.x+r.w) ? d->x+d->w : r.x+r.w;
+			y1 = (d->y+d->h > r.y+r.h) ? d->y+d->h : r.y+r.h;
+			r.x = x; r.y = y; r.w = x1-x; r.h = y1-y;
+			layer->dirty[i] = layer->dirty[--layer->ndirty];
+			merged = 1;
+			break;
+		}
+	} while (merged);
+
+	if (layer->ndirty == OLEDMAXDIRTY) {
+		d = &layer->dirty[OLEDMAXDIRTY-1];
+		x = (d->x < r.x) ? d->x : r.x;
+		y = (d->y < r.y) ? d->y : r.y;
+		x1 = (d->x+d->w > r.x+r.w) ? d->x+d->w : r.x+r.w;
+		y1 = (d->y+d->h > r.y+r.h) ? d->y+d->h : r.y+r.h;
+		--layer->ndirty;
+		addrect(layer, x, y, x1-x, y1-y);
+		return;
+	}
+	layer->dirty[layer->ndirty++] = r;
+	return;
+}
+
+static void restore(struct oledspritelayer *layer, const struct oledrect *r) {
+/******************************************************************************/
+/*                                                                            */
+/* Copy the background back into the framebuffer under one (clipped) rect.    */
+/*                                                                            */
+/******************************************************************************/
+	char (*fb)[COLUMNS] = (char (*)[COLUMNS])oledgetfb();
+	int r0, r1, pg, c;
+	uint8_t m;
+
+	r0 = r->y-ORIGIN;
+	r1 = r->y+r->h-ORIGIN-1;
+	for (pg=r0/ROWSPERPAGE; pg<=r1/ROWSPERPAGE; pg++) {
+		// Mask of the rows of this page inside the rectangle
+		m = 0xFF;
+		if (pg == r0/ROWSPERPAGE) m &= 0xFF << (r0%ROWSPERPAGE);
+		if (pg == r1/ROWSPERPAGE) m &= 0xFF >> (ROWSPERPAGE-1-r1%ROWSPERPAGE);
+		for (c=r->x-ORIGIN; c<r->x+r->w-ORIGIN; c++)
+			fb[pg][c] = (fb[pg][c] & ~m) | (layer->bg[pg][c] & m);
+	}
+	return;
+}
+
+int oledspriteinit(struct oledspritelayer *layer) {
+/******************************************************************************/
+/*                                                                            */
+/* Empty a sprite layer and take the current framebuffer as its background.   */
+/* Draw the static parts of the screen first, then call this.                 */
+/*                                                                            */
+/******************************************************************************/
+
+	memset(layer, 0, sizeof(*layer));
+	return(oledspritebackground(layer));
+}
+
+int oledspritebackground(struct oledspritelayer *layer) {
+/******************************************************************************/
+/*                                                                            */
+/* Recapture the background from the framebuffer after the static content     */
+/* has been redrawn (with the sprites not drawn, e.g. after oledclear()). All */
+/* sprites are drawn afresh on the next tick.                                 */
+/*                                                                            */
+/******************************************************************************/
+	int i;
+
+	memcpy(layer->bg, oledgetfb(), sizeof(layer->bg));
+	for (i=0; i<layer->count; i++) layer->sprite[i]->drawn = 0;
+	return(0);
+}
+
+int oledspriteadd(struct oledspritelayer *layer, struct oledsprite *s) {
+/******************************************************************************/
+/*                                                                            */
+/* Add a sprite to the layer. It appears on the next tick if visible. Returns */
+/* 0, or LAYERFULL if the layer already holds OLEDMAXSPRITES sprites.         */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK(layer->count == OLEDMAXSPRITES, LAYERFULL);
+	s->drawn = 0;
+	layer->sprite[layer->count++] = s;
+	return(0);
+}
+
+int oledspriteremove(struct oledspritelayer *layer, struct oledsprite *s) {
+/******************************************************************************/
+/*                                                                            */
+/* Take a sprite off the layer. The background reappears under it on the      */
+/* next tick. Returns 0, or NOTONLAYER if the sprite was not on the layer.    */
+/*                                                                            */
+/******************************************************************************/
+	int i;
+
+	for (i=0; i<layer->count; i++) {
+		if (layer->sprite[i] != s) continue;
+		if (s->drawn) addrect(layer, s->drawnx, s->drawny, s->w, s->h);
+		s->drawn = 0;
+		memmove(&layer->sprite[i], &layer->sprite[i+1],
+		        (layer->count-i-1)*sizeof(layer->sprite[0]));
+		--layer->count;
+		return(0);
+	}
+	return(olederror(NOTONLAYER));
+}
+
+int oledspritetick(int pi, int fd, struct oledspritelayer *layer, uint8_t fbwrite) {
+/******************************************************************************/
+/*                                                                            */
+/* Advance the layer by one tick:                                             */
+/*  1. step the animation frame of sprites with frameticks set                */
+/*  2. collect the old and new bounds of every sprite that changed            */
+/*  3. widen that damage to the whole of any sprite it touches, so sprites    */
+/*     overlapping a changed one are redrawn completely and in z order        */
+/*  4. restore the background under the damage and redraw the sprites in it   */
+/*  5. flush the damaged rectangles if fbwrite is FBANDDISPLAY                */
+/* Returns 0, or a pigpiod error from the flush.                              */
+/*                                                                            */
+/******************************************************************************/
+	struct oledsprite *s, *t;
+	struct oledrect b;
+	int i, j, grown, err;
+	const uint8_t *bits;
+	size_t size;
+
+	OLEDCHECK((fbwrite != FBONLY) && (fbwrite != FBANDDISPLAY), INVALIDFBCODE);
+
+	++layer->ticks;
+
+	/* Sort by z (insertion sort - the list is short and nearly always in order) */
+
+	for (i=1; i<layer->count; i++) {
+		t = layer->sprite[i];
+		for (j=i; (j > 0) && (layer->sprite[j-1]->z > t->z); j--)
+			layer->sprite[j] = layer->sprite[j-1];
+		layer->sprite[j] = t;
+	}
+
+	/* Animate and collect damage from sprites that changed */
+
+	for (i=0; i<layer->count; i++) {
+		s = layer->sprite[i];
+		if ((s->frameticks > 0) && (s->nframes > 1) && ((layer->ticks % s->frameticks) == 0))
+			s->frame = (s->frame+1) % s->nframes;
+
+		if (s->drawn && s->visible && (s->x == s->drawnx) && (s->y == s->drawny) &&
+		    (s->frame == s->drawnframe) && (s->z == s->drawnz)) continue;
+
+		if (s->drawn) addrect(layer, s->drawnx, s->drawny, s->w, s->h);
+		if (s->visible) addrect(layer, s->x, s->y, s->w, s->h);
+		s->drawn = 0;
+	}
+
+	/* Any sprite touching the damage must be redrawn whole, which may in */
+	/* turn damage more of the screen - repeat until nothing new is hit.  */
+
+	do {
+		grown = 0;
+		for (i=0; i<layer->count; i++) {
+			s = layer->sprite[i];
+			if (!s->visible || !clipbounds(s, &b)) continue;
+			for (j=0; j<layer->ndirty; j++)
+				if (overlaps(&b, &layer->dirty[j])) break;
+			if (j == layer->ndirty) continue;      // Untouched
+			if (contains(&layer->dirty[j], &b)) continue;
+			addrect(layer, b.x, b.y, b.w, b.h);    // Merges into the damage
+			grown = 1;
+		}
+	} while (grown);
+
+	/* Restore the background, then composite sprites bottom to top */
+
+	for (j=0; j<layer->ndirty; j++) restore(layer, &layer->dirty[j]);
+
+	for (i=0; i<layer->count; i++) {
+		s = layer->sprite[i];
+		if (!s->visible) continue;
+		b.x = s->x; b.y = s->y; b.w = s->w; b.h = s->h;
+		for (j=0; j<layer->ndirty; j++) {
+			if (!overlaps(&b, &layer->dirty[j])) continue;
+			size = (size_t)s->w*((s->h+ROWSPERPAGE-1)/ROWSPERPAGE);
+			bits = s->bits+size*s->frame;
+			if (s->mask != NULL)
+				oledbitmap(pi, fd, s->mask+size*s->frame, s->w, s->h, s->x, s->y, PIXOFF, FBONLY);
+			oledbitmap(pi, fd, bits, s->w, s->h, s->x, s->y, PIXON, FBONLY);
+			break;
+		}
+		s->drawn = 1;
+		s->drawnx = s->x; s->drawny = s->y; s->drawnframe = s->frame; s->drawnz = s->z;
+	}
+
+	/* Flush only the damaged rectangles */
+
+	err = 0;
+	for (j=0; j<layer->ndirty; j++) {
+		if ((fbwrite == FBANDDISPLAY) && (err == 0))
+			err = oledflushrect(pi, fd, layer->dirty[j].x, layer->dirty[j].y,
+			                    layer->dirty[j].w, layer->dirty[j].h);
+	}
+	layer->ndirty = 0;
+
+	return(err);
+}
+
+int oledspriterun(int pi, int fd, struct oledspritelayer *layer, int hz,
+                  int (*update)(struct oledspritelayer *layer, void *ctx), void *ctx) {
+/******************************************************************************/
+/*                                                                            */
+/* Simple fixed rate scheduler. Every 1/hz seconds (on absolute deadlines, so */
+/* no drift) call update() to move the sprites, then tick and flush the       */
+/* layer. Stops when update() returns non-zero, returning that value, or on a */
+/* pigpiod error. If a tick overruns its slot the next one starts at once.    */
+/* Returns BADRATE at once if hz is below 1 or update is NULL.                */
+/*                                                                            */
+/******************************************************************************/
+	struct timespec next;
+	int i;
+
+	OLEDCHECK((hz < 1) || (update == NULL), BADRATE);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (1) {
+		i = update(layer, ctx);
+		if (i != 0) return(i);
+		i = oledspritetick(pi, fd, layer, FBANDDISPLAY);
+		if (i != 0) return(i);
+
+		next.tv_nsec += NSPERSEC/hz;
+		while (next.tv_nsec >= NSPERSEC) {
+			next.tv_nsec -= NSPERSEC;
+			++next.tv_sec;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+	}
+}
@@ -20,7 +20,7 @@
 /* Testing loop */
 
 int main() {
-        int ipi,fdoled,i; 			
+        int ipi,fdoled,i=0;
 
         ipi=pigpio_start(NULL,NULL);	// Initialise connection to pigpiod */ 
         if (ipi < 0) {
@@ -34,6 +34,10 @@ int main() {
                 exit(1);
         }
 
+	// Report any library errors on stderr as they happen
+
+	oledseterrorhandler(olederror_fprintf);
+
 	// Initialize the oled display
 
         if (oledinit(ipi,fdoled) == 0) {
@@ -0,0 +1,278 @@
+/******************************************************************************/
+/*                                                                            */
+/* Multi-panel video wall support for the                                     */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A wall is cols x rows panels making one logical display of cols*128 by     */
+/* rows*64 pixels, (1,1) bottom left. Its framebuffer is one allocation cut   */
+/* into 1024 byte tiles, one per panel, each in the library's framebuffer     */
+/* layout - so oledwallselect() points the library at a tile and every        */
+/* drawing function works on that panel unchanged (with FBONLY).              */
+/* oledwallpixel() draws in wall co-ordinates.                                */
+/*                                                                            */
+/* Panels are added with the I2C bus they sit on. oledwallstart() starts one  */
+/* worker thread per bus; oledwallflush() wakes them all and waits, so a      */
+/* frame takes as long as the slowest bus rather than the sum of them. Each   */
+/* worker flushes its panels with oledflushdiff() against a shadow of what    */
+/* the panel shows, so unchanged tiles, pages and columns stay off the bus.   */
+/*                                                                            */
+/* pigpiod runs the commands from one connection one at a time, so give each  */
+/* bus its own pigpio_start() connection or the buses won't overlap.          */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define ROWS            64      // Display has 64 rows of visible pixels.
+#define ROWSPERPAGE     8       // 8 rows of pixels per page = 64 rows per display.
+#define ORIGIN          1       // Bottom left pixel is (1,1).
+#define TILESIZE        (COLUMNS*ROWS/ROWSPERPAGE)
+
+int oledwallinit(struct oledwall *w, int cols, int rows) {
+/******************************************************************************/
+/*                                                                            */
+/* Set up an empty cols x rows panel wall with a blank framebuffer. Returns   */
+/* 0, BADIMAGE if the wall has no panels or more than OLEDWALLMAX, or -1      */
+/* (errno set) if there is not enough memory.                                 */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK((cols < 1) || (rows < 1) || (cols*rows > OLEDWALLMAX), BADIMAGE);
+
+	memset(w, 0, sizeof(*w));
+	w->cols = cols;
+	w->rows = rows;
+	w->fb = calloc((size_t)cols*rows, TILESIZE);
+	if (w->fb == NULL) return(-1);
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->go, NULL);
+	pthread_cond_init(&w->done, NULL);
+
+	return(0);
+}
+
+int oledwalladd(struct oledwall *w, int tx, int ty, int pi, int fd, int bus) {
+/******************************************************************************/
+/*                                                                            */
+/* Put the panel reached with pi and fd at tile (tx,ty) of the wall, (0,0)    */
+/* being the bottom left panel. bus is any number naming the I2C bus the      */
+/* panel is on (e.g. 1 for /dev/i2c-1); panels sharing a bus are flushed one  */
+/* after the other by the same worker. The panel is sent in full on the first */
+/* flush. Call before oledwallstart().                                        */
+/*                                                                            */
+/******************************************************************************/
+	struct oledwallpanel *p;
+	int i;
+
+	OLEDCHECK((tx < 0) || (tx >= w->cols), COLOUTOFRANGE);
+	OLEDCHECK((ty < 0) || (ty >= w->rows), ROWOUTOFRANGE);
+	OLEDCHECK(w->npanels == OLEDWALLMAX, BADIMAGE);
+
+	p = &w->panel[w->npanels];
+	p->pi = pi;
+	p->fd = fd;
+	p->bus = bus;
+	p->tile = w->fb+(size_t)(ty*w->cols+tx)*TILESIZE;
+	p->fresh = 1;
+	p->bytes = 0;
+
+	// A new bus gets a worker of its own
+	for (i=0; (i < w->nbus) && (w->bus[i].id != bus); i++);
+	if (i == w->nbus) {
+		OLEDCHECK(w->nbus == OLEDWALLMAX, BADIMAGE);
+		w->bus[i].id = bus;
+		w->nbus++;
+	}
+
+	w->npanels++;
+	return(0);
+}
+
+int oledwallselect(struct oledwall *w, int tx, int ty) {
+/******************************************************************************/
+/*                                                                            */
+/* Make tile (tx,ty) the library's framebuffer, so the drawing functions      */
+/* (with FBONLY) draw on that panel in its own 128x64 co-ordinates.           */
+/* oledsetfb(NULL) goes back to the library's own framebuffer.                */
+/*                                                                            */
+/******************************************************************************/
+
+	OLEDCHECK((tx < 0) || (tx >= w->cols), COLOUTOFRANGE);
+	OLEDCHECK((ty < 0) || (ty >= w->rows), ROWOUTOFRANGE);
+
+	oledsetfb(w->fb+(size_t)(ty*w->cols+tx)*TILESIZE);
+	return(0);
+}
+
+int oledwallpixel(struct oledwall *w, int x, int y, uint8_t mode) {
+/******************************************************************************/
+/*                                                                            */
+/* Set (PIXON), clear (PIXOFF) or invert (PIXINV) pixel (x,y) of the wall,    */
+/* (1,1) being the bottom left of the bottom left panel.                      */
+/*                                                                            */
+/******************************************************************************/
+	char *b;
+	uint8_t bit;
+	int cx, cy;
+
+	OLEDCHECK(mode > PIXINV, BADPIXELCMD);
+	OLEDCHECK((x < ORIGIN) || (x >= w->cols*COLUMNS+ORIGIN), COLOUTOFRANGE);
+	OLEDCHECK((y < ORIGIN) || (y >= w->rows*ROWS+ORIGIN), ROWOUTOFRANGE);
+
+	cx = x-ORIGIN;
+	cy = y-ORIGIN;
+	b = w->fb+(size_t)((cy/ROWS)*w->cols+cx/COLUMNS)*TILESIZE
+	         +((cy%ROWS)/ROWSPERPAGE)*COLUMNS+cx%COLUMNS;
+	bit = 0x01 << (cy%ROWSPERPAGE);
+	if (mode == PIXON) *b |= bit;
+	else if (mode == PIXOFF) *b &= ~bit;
+	else *b ^= bit;
+
+	return(0);
+}
+
+static int oledwallbusflush(struct oledwall *w, int bus, long *sent) {
+	// Bring every panel on the bus up to date with its tile
+	struct oledwallpanel *p;
+	int i, k;
+
+	*sent = 0;
+	for (i=0; i<w->npanels; i++) {
+		p = &w->panel[i];
+		if (p->bus != bus) continue;
+		if (p->fresh) {                 // Unknown contents - make every byte differ
+			for (k=0; k<TILESIZE; k++) p->shadow[k/COLUMNS][k%COLUMNS] = ~p->tile[k];
+			p->fresh = 0;
+		}
+		k = oledflushdiff(p->pi, p->fd, p->tile, (char *)p->shadow);
+		if (k < 0) {
+			p->fresh = 1;           // Don't trust the shadow after a failed write
+			return(k);
+		}
+		p->bytes += k;
+		*sent += k;
+	}
+	return(0);
+}
+
+static void *oledwallworker(void *arg) {
+	// Wait for each flush request, flush this bus's panels, report back
+	struct oledwallbus *b = arg;
+	struct oledwall *w = b->wall;
+	long gen = b->gen, sent;
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (w->running && (w->gen == gen)) pthread_cond_wait(&w->go, &w->lock);
+		if (!w->running) break;
+		gen = w->gen;
+		pthread_mutex_unlock(&w->lock);
+
+		i = oledwallbusflush(w, b->id, &sent);
+
+		pthread_mutex_lock(&w->lock);
+		b->error = i;
+		b->sent = sent;
+		if (--w->pending == 0) pthread_cond_signal(&w->done);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return(NULL);
+}
+
+int oledwallstart(struct oledwall *w) {
+/******************************************************************************/
+/*                                                                            */
+/* Start a flushing thread for each bus. Returns 0 or the pthread error code  */
+/* (no threads are left running if one can't be started). Without them,       */
+/* oledwallflush() flushes the buses one after the other itself.              */
+/*                                                                            */
+/******************************************************************************/
+	int k;
+
+	w->running = 1;
+	for (w->threads=0; w->threads<w->nbus; w->threads++) {
+		// Requests made before a restart are done - count on from the latest
+		pthread_mutex_lock(&w->lock);
+		w->bus[w->threads].gen = w->gen;
+		pthread_mutex_unlock(&w->lock);
+		w->bus[w->threads].wall = w;
+		k = pthread_create(&w->bus[w->threads].thread, NULL, oledwallworker, &w->bus[w->threads]);
+		if (k != 0) {
+			oledwallstop(w);
+			return(k);
+		}
+	}
+	return(0);
+}
+
+int oledwallflush(struct oledwall *w) {
+/******************************************************************************/
+/*                                                                            */
+/* Flush the whole wall, every bus at once, and wait for all of them. Don't   */
+/* draw on the wall until it returns. Returns the bytes of display data sent, */
+/* or the first pigpiod error any bus hit (the other buses still finish).     */
+/*                                                                            */
+/******************************************************************************/
+	long sent = 0;
+	int i, err = 0;
+
+	if (!w->running) {                      // Not started - flush from here
+		for (i=0; i<w->nbus; i++) {
+			w->bus[i].error = oledwallbusflush(w, w->bus[i].id, &w->bus[i].sent);
+			if ((w->bus[i].error != 0) && (err == 0)) err = w->bus[i].error;
+			sent += w->bus[i].sent;
+		}
+		return((err != 0) ? err : (int)sent);
+	}
+
+	pthread_mutex_lock(&w->lock);
+	w->pending = w->nbus;
+	w->gen++;
+	pthread_cond_broadcast(&w->go);
+	while (w->pending > 0) pthread_cond_wait(&w->done, &w->lock);
+
+	for (i=0; i<w->nbus; i++) {
+		if ((w->bus[i].error != 0) && (err == 0)) err = w->bus[i].error;
+		sent += w->bus[i].sent;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return((err != 0) ? err : (int)sent);
+}
+
+void oledwallstop(struct oledwall *w) {
+/******************************************************************************/
+/*                                                                            */
+/* Stop the flushing threads.                                                 */
+/*                                                                            */
+/******************************************************************************/
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	w->running = 0;
+	pthread_cond_broadcast(&w->go);
+	pthread_mutex_unlock(&w->lock);
+
+	for (i=0; i<w->threads; i++) pthread_join(w->bus[i].thread, NULL);
+	w->threads = 0;
+	return;
+}
+
+void oledwallfree(struct oledwall *w) {
+/******************************************************************************/
+/*                                                                            */
+/* Release the wall's framebuffer. Stop it first if it was started. If the    */
+/* library is still drawing on one of its tiles, call oledsetfb(NULL) too.    */
+/*                                                                            */
+/******************************************************************************/
+
+	free(w->fb);
+	w->fb = NULL;
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->go);
+	pthread_cond_destroy(&w->done);
+	return;
+}
@@ -0,0 +1,128 @@
+/******************************************************************************/
+/*                                                                            */
+/* Wire format test for the                                                   */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* Records every write the library makes through oledsettransport() and       */
+/* checks the exact bytes sent by oledinit(), oledflushfb() and               */
+/* oledsetpixel() - a 0x00 control byte before a command stream, 0x80 before  */
+/* each command that has another control byte after it and 0x40 before        */
+/* display data.                                                              */
+/* Needs no display or pigpiod: 'make test' builds it with -DOLEDNOPIGPIO     */
+/* and runs it. Exits non-zero if any write differs.                          */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define COLUMNS         128     // Display has 128 columns of visible pixels.
+#define PAGES           8       // Display has 8 pages of 8 rows each.
+#define MAXWRITES       64      // Most writes recorded per test
+#define MAXLEN          (7+COLUMNS)
+
+struct wirelog {
+	int n;
+	unsigned len[MAXWRITES];
+	uint8_t buf[MAXWRITES][MAXLEN];
+};
+
+static int failures;
+
+static int record(void *ctx, int pi, int fd, char *buf, unsigned len) {
+	// Transport that keeps a copy of each write instead of sending it
+	struct wirelog *w = ctx;
+
+	if ((w->n < MAXWRITES) && (len <= MAXLEN)) {
+		w->len[w->n] = len;
+		memcpy(w->buf[w->n], buf, len);
+	}
+	++w->n;
+	return(0);
+}
+
+static void expect(const char *what, const struct wirelog *w, int k, const uint8_t *want, unsigned len) {
+	// Compare write k of the log with want and report the first difference
+	unsigned i;
+
+	if (k >= w->n) {
+		printf("FAIL %s: write %d missing (%d writes)\n", what, k, w->n);
+		++failures;
+		return;
+	}
+	if (w->len[k] != len) {
+		printf("FAIL %s: write %d is %u bytes, expected %u\n", what, k, w->len[k], len);
+		++failures;
+		return;
+	}
+	for (i=0; i<len; i++) {
+		if (w->buf[k][i] == want[i]) continue;
+		printf("FAIL %s: write %d byte %u is 0x%02X, expected 0x%02X\n", what, k, i, w->buf[k][i], want[i]);
+		++failures;
+		return;
+	}
+}
+
+static void expectcount(const char *what, const struct wirelog *w, int n) {
+	if (w->n == n) return;
+	printf("FAIL %s: %d writes, expected %d\n", what, w->n, n);
+	++failures;
+}
+
+static unsigned pagewrite(uint8_t *want, int page, int col, const char *data, int n) {
+	// The write that puts n bytes at col (0 based) of page (0 based)
+	want[0] = 0x80;
+	want[1] = (col+2) & 0x0F;       // Visible columns start at RAM column 2
+	want[2] = 0x80;
+	want[3] = 0x10 | ((col+2) >> 4);
+	want[4] = 0x80;
+	want[5] = 0xB0+page;
+	want[6] = 0x40;
+	memcpy(want+7, data, n);
+	return(7+n);
+}
+
+int main(void) {
+	static struct wirelog w;
+	static const uint8_t init[] = {0x00, 0xAE, 0x81, 0x80, 0xA1, 0xA6, 0xA8, 0x3F, 0xAD, 0x8B,
+	                               0x30, 0xC0, 0xD3, 0x00, 0xD5, 0x80, 0xD9, 0x1F, 0xDA, 0x12,
+	                               0xDB, 0x40};
+	static const uint8_t on[] = {0x00, 0x02, 0x10, 0x40, 0xAF};
+	static const char blank[COLUMNS];
+	uint8_t want[MAXLEN];
+	char *fb;
+	int p, c;
+
+	oledsettransport(record, &w);
+
+	// oledinit(): the setup commands, a cleared display, then display on
+	w.n = 0;
+	if (oledinit(0,0) != 0) ++failures;
+	expectcount("oledinit", &w, 1+PAGES+1);
+	expect("oledinit", &w, 0, init, sizeof(init));
+	for (p=0; p<PAGES; p++) expect("oledinit clear", &w, 1+p, want, pagewrite(want, p, 0, blank, COLUMNS));
+	expect("oledinit", &w, 1+PAGES, on, sizeof(on));
+
+	// oledflushfb(): one write per page, framebuffer page 1 to display page 0
+	fb = oledgetfb();
+	for (p=0; p<PAGES; p++)
+		for (c=0; c<COLUMNS; c++) fb[p*COLUMNS+c] = (char)(p*37+c*11);
+	w.n = 0;
+	if (oledflushfb(0,0) != 0) ++failures;
+	expectcount("oledflushfb", &w, PAGES);
+	for (p=0; p<PAGES; p++) expect("oledflushfb", &w, p, want, pagewrite(want, p, 0, fb+p*COLUMNS, COLUMNS));
+
+	// oledsetpixel(): (5,10) is column 4, bit 1 of page 1; one byte is sent
+	memset(fb, 0, PAGES*COLUMNS);
+	w.n = 0;
+	if (oledsetpixel(0,0,5,10,PIXON,FBANDDISPLAY) != 0) ++failures;
+	expectcount("oledsetpixel", &w, 1);
+	expect("oledsetpixel", &w, 0, want, pagewrite(want, 1, 4, "\x02", 1));
+
+	// Framebuffer only drawing sends nothing
+	w.n = 0;
+	if (oledsetpixel(0,0,128,64,PIXON,FBONLY) != 0) ++failures;
+	expectcount("oledsetpixel FBONLY", &w, 0);
+
+	oledsettransport(NULL, NULL);
+	printf("%s\n", failures ? "Wire format test FAILED" : "Wire format test passed");
+	return(failures ? 1 : 0);
+}
@@ -0,0 +1,138 @@
+/******************************************************************************/
+/*                                                                            */
+/* pigpiod request count for the                                              */
+/* SH1106 132x64 (128x64) pixel OLED display library for I2C bus.             */
+/*                                                                            */
+/* A stand-in for libpigpiod_if2: i2c_write_device() and i2c_zip() are        */
+/* defined here and count the requests that would go to the daemon, so the    */
+/* library is linked without pigpiod and no display or daemon is needed.      */
+/* Prints the requests sent per oledflushfb() while i2c_zip() is accepted,    */
+/* then with the stub answering i2c_zip() as a pigpiod without it would, so   */
+/* the library falls back to one i2c_write_device() per write, and checks     */
+/* both send the same I2C writes. A failed write inside a batch must be       */
+/* returned without turning batching off.                                     */
+/*                                                                            */
+/* 'make zipcount' builds it (it needs pigpiod_if2.h, but not the library)    */
+/* and runs it. Exits non-zero if the two paths differ.                       */
+/*                                                                            */
+/******************************************************************************/
+#include "oled1106.h"
+
+#define FLUSHES         100     // oledflushfb() calls counted per path
+#define HANDLE          3       // The I2C handle the library is given
+#define ZIPESC          1       // i2c_zip: next parameter is 2 bytes
+#define ZIPWRITE        7       // i2c_zip: write P bytes
+#define ZIPEND          0       // i2c_zip: end of commands
+
+static struct {
+	int rejectzip;                  // Fail every i2c_zip() as an old pigpiod would
+	int nack;                       // Fail the next i2c_zip() as a NACK would
+	long requests, zips, writes, bytes, bad;
+	unsigned long sum;              // Checksum of every byte written, in order
+} stub;
+
+static void onwrite(const char *buf, unsigned n) {
+	// One I2C write on the bus, whichever request carried it
+	unsigned k;
+
+	++stub.writes;
+	stub.bytes += n;
+	for (k=0; k<n; k++) stub.sum = stub.sum*31+(uint8_t)buf[k];
+}
+
+int i2c_write_device(int pi, unsigned handle, char *buf, unsigned count) {
+	++stub.requests;
+	if (handle != HANDLE) ++stub.bad;
+	onwrite(buf, count);
+	return(0);
+}
+
+int i2c_zip(int pi, unsigned handle, char *inBuf, unsigned inLen, char *outBuf, unsigned outLen) {
+	// Walk the command sequence the way pigpiod would, handling only writes
+	unsigned p = 0, n;
+
+	++stub.requests;
+	if (handle != HANDLE) ++stub.bad;
+	if (stub.rejectzip) return(PI_UNKNOWN_COMMAND);
+	if (stub.nack) {
+		stub.nack = 0;
+		return(PI_I2C_WRITE_FAILED);
+	}
+	++stub.zips;
+
+	while ((p < inLen) && (inBuf[p] != ZIPEND)) {
+		if ((inBuf[p] == ZIPESC) && (p+3 < inLen) && (inBuf[p+1] == ZIPWRITE)) {
+			n = (uint8_t)inBuf[p+2] | ((uint8_t)inBuf[p+3] << 8);
+			p += 4;
+		}
+		else if ((inBuf[p] == ZIPWRITE) && (p+1 < inLen)) {
+			n = (uint8_t)inBuf[p+1];
+			p += 2;
+		}
+		else break;
+		if (p+n > inLen) break;
+		onwrite(inBuf+p, n);
+		p += n;
+	}
+	if ((p >= inLen) || (inBuf[p] != ZIPEND)) {
+		++stub.bad;
+		return(-1);
+	}
+	return(0);
+}
+
+static unsigned long measure(const char *what, int flushes) {
+	// Count the requests made by some full flushes; returns the checksum
+	int f, i = 0;
+
+	stub.requests = stub.zips = stub.writes = stub.bytes = 0;
+	stub.sum = 0;
+	for (f=0; f<flushes; f++) i |= oledflushfb(0,HANDLE);
+	if (i != 0) {
+		printf("FAIL oledflushfb() returned an error\n");
+		++stub.bad;
+	}
+	printf("%-28s %5.2f requests per oledflushfb() (%ld i2c_zip), %ld writes of %ld bytes\n",
+	       what, (double)stub.requests/flushes, stub.zips, stub.writes/flushes, stub.bytes/flushes);
+	return(stub.sum);
+}
+
+int main(void) {
+	unsigned long one, many;
+	char *fb = oledgetfb();
+	int k;
+
+	for (k=0; k<1024; k++) fb[k] = (char)(k*7);
+
+	one = measure("First flush:", 1);
+	many = measure("With i2c_zip():", FLUSHES);
+
+	// A display that doesn't answer is an error, not a reason to stop batching
+	stub.nack = 1;
+	if (oledflushfb(0,HANDLE) != PI_I2C_WRITE_FAILED) {
+		printf("FAIL a failed write inside i2c_zip() wasn't returned\n");
+		++stub.bad;
+	}
+	if (measure("After a failed write:", FLUSHES) != many) {
+		printf("FAIL the writes after a failed one differ\n");
+		++stub.bad;
+	}
+	if (stub.zips != FLUSHES) {
+		printf("FAIL a failed write turned batching off\n");
+		++stub.bad;
+	}
+
+	// The first rejected i2c_zip() turns batching off and its writes are resent
+	stub.rejectzip = 1;
+	if (measure("First i2c_zip() rejected:", 1) != one) {
+		printf("FAIL the writes resent after i2c_zip() fails differ\n");
+		++stub.bad;
+	}
+	if (measure("i2c_zip() rejected:", FLUSHES) != many) {
+		printf("FAIL the unbatched writes differ\n");
+		++stub.bad;
+	}
+
+	if (stub.bad != 0) printf("FAIL %ld bad requests\n", stub.bad);
+	return(stub.bad ? 1 : 0);
+}